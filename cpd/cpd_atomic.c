@@ -0,0 +1,224 @@
+/*
+// Copyright (c) 2015-2016 Pierre Guillot.
+// For information on usage and redistribution, and for a DISCLAIMER OF ALL
+// WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+*/
+
+
+#include "cpd_atomic.h"
+
+#ifdef _WIN32
+
+long cpd_atomic_int_load(cpd_atomic_int* atom)
+{
+    return InterlockedCompareExchange(atom, 0, 0);
+}
+
+void cpd_atomic_int_store(cpd_atomic_int* atom, long value)
+{
+    InterlockedExchange(atom, value);
+}
+
+long cpd_atomic_int_exchange(cpd_atomic_int* atom, long value)
+{
+    return InterlockedExchange(atom, value);
+}
+
+char cpd_atomic_int_compare_exchange(cpd_atomic_int* atom, long expected, long value)
+{
+    return InterlockedCompareExchange(atom, value, expected) == expected;
+}
+
+long cpd_atomic_int_fetch_add(cpd_atomic_int* atom, long value)
+{
+    return InterlockedExchangeAdd(atom, value);
+}
+
+long long cpd_atomic_int64_load(cpd_atomic_int64* atom)
+{
+    return InterlockedCompareExchange64(atom, 0, 0);
+}
+
+void cpd_atomic_int64_store(cpd_atomic_int64* atom, long long value)
+{
+    InterlockedExchange64(atom, value);
+}
+
+char cpd_atomic_int64_compare_exchange(cpd_atomic_int64* atom, long long expected, long long value)
+{
+    return InterlockedCompareExchange64(atom, value, expected) == expected;
+}
+
+long long cpd_atomic_int64_fetch_add(cpd_atomic_int64* atom, long long value)
+{
+    return InterlockedExchangeAdd64(atom, value);
+}
+
+void* cpd_atomic_ptr_load(cpd_atomic_ptr* atom)
+{
+    return InterlockedCompareExchangePointer(atom, NULL, NULL);
+}
+
+void cpd_atomic_ptr_store(cpd_atomic_ptr* atom, void* value)
+{
+    InterlockedExchangePointer(atom, value);
+}
+
+void* cpd_atomic_ptr_exchange(cpd_atomic_ptr* atom, void* value)
+{
+    return InterlockedExchangePointer(atom, value);
+}
+
+char cpd_atomic_ptr_compare_exchange(cpd_atomic_ptr* atom, void* expected, void* value)
+{
+    return InterlockedCompareExchangePointer(atom, value, expected) == expected;
+}
+
+#elif defined(__ATOMIC_SEQ_CST)
+
+long cpd_atomic_int_load(cpd_atomic_int* atom)
+{
+    return __atomic_load_n(atom, __ATOMIC_SEQ_CST);
+}
+
+void cpd_atomic_int_store(cpd_atomic_int* atom, long value)
+{
+    __atomic_store_n(atom, value, __ATOMIC_SEQ_CST);
+}
+
+long cpd_atomic_int_exchange(cpd_atomic_int* atom, long value)
+{
+    return __atomic_exchange_n(atom, value, __ATOMIC_SEQ_CST);
+}
+
+char cpd_atomic_int_compare_exchange(cpd_atomic_int* atom, long expected, long value)
+{
+    return __atomic_compare_exchange_n(atom, &expected, value, 0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+}
+
+long cpd_atomic_int_fetch_add(cpd_atomic_int* atom, long value)
+{
+    return __atomic_fetch_add(atom, value, __ATOMIC_SEQ_CST);
+}
+
+long long cpd_atomic_int64_load(cpd_atomic_int64* atom)
+{
+    return __atomic_load_n(atom, __ATOMIC_SEQ_CST);
+}
+
+void cpd_atomic_int64_store(cpd_atomic_int64* atom, long long value)
+{
+    __atomic_store_n(atom, value, __ATOMIC_SEQ_CST);
+}
+
+char cpd_atomic_int64_compare_exchange(cpd_atomic_int64* atom, long long expected, long long value)
+{
+    return __atomic_compare_exchange_n(atom, &expected, value, 0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+}
+
+long long cpd_atomic_int64_fetch_add(cpd_atomic_int64* atom, long long value)
+{
+    return __atomic_fetch_add(atom, value, __ATOMIC_SEQ_CST);
+}
+
+void* cpd_atomic_ptr_load(cpd_atomic_ptr* atom)
+{
+    return __atomic_load_n(atom, __ATOMIC_SEQ_CST);
+}
+
+void cpd_atomic_ptr_store(cpd_atomic_ptr* atom, void* value)
+{
+    __atomic_store_n(atom, value, __ATOMIC_SEQ_CST);
+}
+
+void* cpd_atomic_ptr_exchange(cpd_atomic_ptr* atom, void* value)
+{
+    return __atomic_exchange_n(atom, value, __ATOMIC_SEQ_CST);
+}
+
+char cpd_atomic_ptr_compare_exchange(cpd_atomic_ptr* atom, void* expected, void* value)
+{
+    return __atomic_compare_exchange_n(atom, &expected, value, 0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+}
+
+#else
+
+long cpd_atomic_int_load(cpd_atomic_int* atom)
+{
+    return __sync_fetch_and_add(atom, 0);
+}
+
+void cpd_atomic_int_store(cpd_atomic_int* atom, long value)
+{
+    __sync_synchronize();
+    *atom = value;
+    __sync_synchronize();
+}
+
+long cpd_atomic_int_exchange(cpd_atomic_int* atom, long value)
+{
+    __sync_synchronize();
+    return __sync_lock_test_and_set(atom, value);
+}
+
+char cpd_atomic_int_compare_exchange(cpd_atomic_int* atom, long expected, long value)
+{
+    return __sync_bool_compare_and_swap(atom, expected, value);
+}
+
+long cpd_atomic_int_fetch_add(cpd_atomic_int* atom, long value)
+{
+    return __sync_fetch_and_add(atom, value);
+}
+
+long long cpd_atomic_int64_load(cpd_atomic_int64* atom)
+{
+    return __sync_val_compare_and_swap(atom, 0, 0);
+}
+
+void cpd_atomic_int64_store(cpd_atomic_int64* atom, long long value)
+{
+    long long expected;
+    do
+    {
+        expected = *atom;
+    }
+    while(!__sync_bool_compare_and_swap(atom, expected, value));
+}
+
+char cpd_atomic_int64_compare_exchange(cpd_atomic_int64* atom, long long expected, long long value)
+{
+    return __sync_bool_compare_and_swap(atom, expected, value);
+}
+
+long long cpd_atomic_int64_fetch_add(cpd_atomic_int64* atom, long long value)
+{
+    return __sync_fetch_and_add(atom, value);
+}
+
+void* cpd_atomic_ptr_load(cpd_atomic_ptr* atom)
+{
+    return __sync_val_compare_and_swap(atom, NULL, NULL);
+}
+
+void cpd_atomic_ptr_store(cpd_atomic_ptr* atom, void* value)
+{
+    __sync_synchronize();
+    *atom = value;
+    __sync_synchronize();
+}
+
+void* cpd_atomic_ptr_exchange(cpd_atomic_ptr* atom, void* value)
+{
+    __sync_synchronize();
+    return __sync_lock_test_and_set(atom, value);
+}
+
+char cpd_atomic_ptr_compare_exchange(cpd_atomic_ptr* atom, void* expected, void* value)
+{
+    return __sync_bool_compare_and_swap(atom, expected, value);
+}
+
+#endif
+
+
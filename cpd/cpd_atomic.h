@@ -0,0 +1,88 @@
+/*
+// Copyright (c) 2015-2016 Pierre Guillot.
+// For information on usage and redistribution, and for a DISCLAIMER OF ALL
+// WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+*/
+
+#ifndef cpd_atomic_h
+#define cpd_atomic_h
+
+#include "cpd_def.h"
+
+//! @defgroup atomic atomic
+//! @brief The atomic part of cpd.
+//! @details This part manages atomic integers and pointers. All the operations are
+//! sequentially consistent.
+
+//! @addtogroup atomic
+//! @{
+
+//! @brief The atomic integer.
+#ifdef _WIN32
+#include <windows.h>
+typedef volatile LONG cpd_atomic_int;
+#else
+typedef volatile long cpd_atomic_int;
+#endif
+
+//! @brief The atomic 64 bits integer.
+//! @details The integer has 64 bits on all the platforms, so it can count sizes of memory
+//! or pack two 32 bits values.
+#ifdef _WIN32
+typedef volatile LONGLONG cpd_atomic_int64;
+#else
+typedef volatile long long cpd_atomic_int64;
+#endif
+
+//! @brief The atomic pointer.
+typedef void* volatile cpd_atomic_ptr;
+
+//! @brief The size of a cache line used to separate the data touched by different threads.
+#define CPD_CACHE_LINE 64
+
+//! @brief Loads the value of an atomic integer.
+CPD_EXTERN long cpd_atomic_int_load(cpd_atomic_int* atom);
+
+//! @brief Stores a value in an atomic integer.
+CPD_EXTERN void cpd_atomic_int_store(cpd_atomic_int* atom, long value);
+
+//! @brief Stores a value in an atomic integer and returns the previous value.
+CPD_EXTERN long cpd_atomic_int_exchange(cpd_atomic_int* atom, long value);
+
+//! @brief Stores a value in an atomic integer if its value is the expected one.
+//! @return 1 if the value has been stored, otherwise 0.
+CPD_EXTERN char cpd_atomic_int_compare_exchange(cpd_atomic_int* atom, long expected, long value);
+
+//! @brief Adds a value to an atomic integer and returns the previous value.
+CPD_EXTERN long cpd_atomic_int_fetch_add(cpd_atomic_int* atom, long value);
+
+//! @brief Loads the value of an atomic 64 bits integer.
+CPD_EXTERN long long cpd_atomic_int64_load(cpd_atomic_int64* atom);
+
+//! @brief Stores a value in an atomic 64 bits integer.
+CPD_EXTERN void cpd_atomic_int64_store(cpd_atomic_int64* atom, long long value);
+
+//! @brief Stores a value in an atomic 64 bits integer if its value is the expected one.
+//! @return 1 if the value has been stored, otherwise 0.
+CPD_EXTERN char cpd_atomic_int64_compare_exchange(cpd_atomic_int64* atom, long long expected, long long value);
+
+//! @brief Adds a value to an atomic 64 bits integer and returns the previous value.
+CPD_EXTERN long long cpd_atomic_int64_fetch_add(cpd_atomic_int64* atom, long long value);
+
+//! @brief Loads the value of an atomic pointer.
+CPD_EXTERN void* cpd_atomic_ptr_load(cpd_atomic_ptr* atom);
+
+//! @brief Stores a value in an atomic pointer.
+CPD_EXTERN void cpd_atomic_ptr_store(cpd_atomic_ptr* atom, void* value);
+
+//! @brief Stores a value in an atomic pointer and returns the previous value.
+CPD_EXTERN void* cpd_atomic_ptr_exchange(cpd_atomic_ptr* atom, void* value);
+
+//! @brief Stores a value in an atomic pointer if its value is the expected one.
+//! @return 1 if the value has been stored, otherwise 0.
+CPD_EXTERN char cpd_atomic_ptr_compare_exchange(cpd_atomic_ptr* atom, void* expected, void* value);
+
+//! @}
+
+
+#endif // cpd_atomic_h
@@ -12,6 +12,7 @@
 #include "cpd_dsp.h"
 #include "../pd/src/m_pd.h"
 #include "../pd/src/s_stuff.h"
+#include "../pd/src/m_imp.h"
 #include <string.h>
 #include <stdlib.h>
 
@@ -22,6 +23,15 @@ extern void cpd_instance_lock(cpd_instance* instance);
 extern void cpd_instance_unlock(cpd_instance *instance);
 extern void cpd_midi_manager_perform(struct cpd_midi_manager* instance);
 extern void cpd_message_manager_perform(struct cpd_message_manager* manager);
+extern void cpd_gui_manager_perform(struct cpd_gui_manager* manager);
+extern void cpd_post_manager_perform(struct cpd_post_manager* manager, char state);
+extern void cpd_memory_perform(char state);
+extern void cpd_memory_prepare();
+extern void cpd_memory_setpolicy(void* owner, char lock, char hugepages);
+extern char cpd_memory_lock_owner(void* owner);
+extern void cpd_memory_unlock_owner(void* owner);
+extern char cpd_patch_index_has_deferred(cpd_instance const* instance);
+extern void cpd_patch_index_free_deferred(cpd_instance* instance);
 
 struct cpd_dsp_manager
 {
@@ -30,6 +40,10 @@ struct cpd_dsp_manager
     int             c_samplerate;
     int             c_ninputs;
     int             c_noutputs;
+    char            c_hugepages;
+    char            c_locked;
+    size_t          c_batch;
+    int             c_batch_state;
 };
 
 
@@ -37,7 +51,12 @@ struct cpd_dsp_manager
 //                                      INTERNAL                                        //
 // ==================================================================================== //
 
-extern void cpd_dsp_manager_init(cpd_instance* instance)
+extern size_t cpd_dsp_manager_size()
+{
+    return sizeof(struct cpd_dsp_manager);
+}
+
+extern void cpd_dsp_manager_init(cpd_instance* instance, void* memory)
 {
     static int initialized = 0;
     if(!initialized)
@@ -46,7 +65,7 @@ extern void cpd_dsp_manager_init(cpd_instance* instance)
         c_sym_pd  = gensym("pd");
         initialized = 1;
     }
-    instance->c_dsp = (struct cpd_dsp_manager *)malloc(sizeof(struct cpd_dsp_manager));
+    instance->c_dsp = (struct cpd_dsp_manager *)memory;
     if(instance->c_dsp)
     {
         instance->c_dsp->c_inputs       = NULL;
@@ -54,6 +73,62 @@ extern void cpd_dsp_manager_init(cpd_instance* instance)
         instance->c_dsp->c_samplerate   = 0;
         instance->c_dsp->c_ninputs      = 0;
         instance->c_dsp->c_noutputs     = 0;
+        instance->c_dsp->c_hugepages    = 0;
+        instance->c_dsp->c_locked       = 0;
+        instance->c_dsp->c_batch        = 0;
+        instance->c_dsp->c_batch_state  = 0;
+    }
+}
+
+extern void cpd_dsp_manager_set_hugepages(cpd_instance* instance, char state)
+{
+    instance->c_dsp->c_hugepages = state;
+}
+
+extern char cpd_dsp_manager_get_hugepages(cpd_instance const* instance)
+{
+    return instance->c_dsp ? instance->c_dsp->c_hugepages : 0;
+}
+
+//! @brief Sets the memory of an instance as locked.
+//! @details The blocks allocated by Pure Data while the instance is locked are locked, the
+//! method doesn't lock the blocks already allocated.
+extern void cpd_dsp_manager_set_locked(cpd_instance* instance, char state)
+{
+    instance->c_dsp->c_locked = state;
+    cpd_memory_setpolicy(instance, state, instance->c_dsp->c_hugepages);
+}
+
+extern char cpd_dsp_manager_get_locked(cpd_instance const* instance)
+{
+    return instance->c_dsp ? instance->c_dsp->c_locked : 0;
+}
+
+//! @brief Checks if a batch of changes is in progress.
+//! @details The patches closed during a batch must be freed at the end of the batch
+//! because the previous DSP chain is still performed.
+extern char cpd_dsp_manager_in_batch(cpd_instance const* instance)
+{
+    return instance->c_dsp->c_batch ? 1 : 0;
+}
+
+//! @brief Stops the previous DSP chain performed during a batch.
+//! @details The DSP state of Pd is cleared during a batch so the changes don't sort the
+//! chain, the state is restored before the suspension so the chain is really stopped.
+static void cpd_dsp_manager_stop_batch(cpd_instance* instance)
+{
+    pd_this->pd_dspstate = instance->c_dsp->c_batch_state;
+    canvas_suspend_dsp();
+}
+
+//! @brief Cancels the batches of changes in progress.
+//! @details The DSP state of Pd is restored so the previous chain can be stopped.
+extern void cpd_dsp_manager_cancel_batch(cpd_instance* instance)
+{
+    if(instance->c_dsp->c_batch)
+    {
+        instance->c_dsp->c_batch = 0;
+        pd_this->pd_dspstate = instance->c_dsp->c_batch_state;
     }
 }
 
@@ -64,7 +139,7 @@ extern void cpd_dsp_manager_clear(cpd_instance* instance)
     instance->c_dsp->c_samplerate   = 0;
     instance->c_dsp->c_ninputs      = 0;
     instance->c_dsp->c_noutputs     = 0;
-    free(instance->c_dsp);
+    instance->c_dsp = NULL;
 }
 
 
@@ -74,6 +149,8 @@ extern void cpd_dsp_manager_clear(cpd_instance* instance)
 
 void cpd_instance_dsp_prepare(cpd_instance* instance, const int nins, const int nouts, const int samplerate, const int nsamples)
 {
+    t_atom av;
+    char changed = 0;
     cpd_instance_lock(instance);
     sys_soundin     = instance->c_dsp->c_inputs;
     sys_soundout    = instance->c_dsp->c_outputs;
@@ -85,17 +162,38 @@ void cpd_instance_dsp_prepare(cpd_instance* instance, const int nins, const int
        || nins != instance->c_dsp->c_ninputs
        || nouts != instance->c_dsp->c_noutputs)
     {
+        // The previous chain of a batch uses the buffers that are going to be freed.
+        if(instance->c_dsp->c_batch)
+        {
+            cpd_dsp_manager_stop_batch(instance);
+        }
         sys_setchsr(nins, nouts, samplerate);
         instance->c_dsp->c_inputs      = sys_soundin;
         instance->c_dsp->c_outputs     = sys_soundout;
         instance->c_dsp->c_ninputs     = sys_inchannels;
         instance->c_dsp->c_noutputs    = sys_outchannels;
         instance->c_dsp->c_samplerate  = sys_getsr();
+        changed = 1;
+    }
+    cpd_memory_prepare();
+    // The DSP chain is only sorted if the DSP isn't running or if the buffers changed, the
+    // loading and the closing of the patches already update the chain. The state of the
+    // DSP is read from Pd because the patches can stop it with a message.
+    if(instance->c_dsp->c_batch)
+    {
+        // The DSP will start at the end of the batch.
+        instance->c_dsp->c_batch_state = 1;
+    }
+    else if(!pd_this->pd_dspstate)
+    {
+        av.a_type = A_FLOAT;
+        av.a_w.w_float = 1;
+        pd_typedmess((t_pd *)c_sym_pd->s_thing, c_sym_dsp, 1, &av);
+    }
+    else if(changed)
+    {
+        canvas_update_dsp();
     }
-    t_atom av;
-    av.a_type = A_FLOAT;
-    av.a_w.w_float = 1;
-    pd_typedmess((t_pd *)c_sym_pd->s_thing, c_sym_dsp, 1, &av);
     cpd_instance_unlock(instance);
 }
 
@@ -107,6 +205,8 @@ void cpd_instance_dsp_perform(cpd_instance* instance, int nsamples, const int ni
     t_sample *ins = instance->c_dsp->c_inputs;
     t_sample *outs = instance->c_dsp->c_outputs;
     cpd_instance_lock(instance);
+    cpd_memory_perform(1);
+    cpd_post_manager_perform(instance->c_post, 1);
     sys_soundin     = instance->c_dsp->c_inputs;
     sys_soundout    = instance->c_dsp->c_outputs;
     sys_inchannels  = instance->c_dsp->c_ninputs;
@@ -117,6 +217,7 @@ void cpd_instance_dsp_perform(cpd_instance* instance, int nsamples, const int ni
     {
         cpd_message_manager_perform(instance->c_message);
         cpd_midi_manager_perform(instance->c_midi);
+        cpd_gui_manager_perform(instance->c_gui);
         for(j = 0; j < nins; j++)
         {
             memcpy(ins+j*DEFDACBLKSIZE, inputs[j]+i, DEFDACBLKSIZE * sizeof(t_sample));
@@ -128,6 +229,65 @@ void cpd_instance_dsp_perform(cpd_instance* instance, int nsamples, const int ni
             memcpy(outputs[j]+i, outs+j*DEFDACBLKSIZE, DEFDACBLKSIZE * sizeof(t_sample));
         }
     }
+    cpd_post_manager_perform(instance->c_post, 0);
+    cpd_memory_perform(0);
+    cpd_instance_unlock(instance);
+}
+
+//! @brief Unlocks the memory of an instance.
+//! @details Must be called while the instance is locked.
+extern void cpd_dsp_manager_unlock(cpd_instance* instance)
+{
+    if(instance->c_dsp->c_locked)
+    {
+        cpd_dsp_manager_set_locked(instance, 0);
+        cpd_memory_unlock_owner(instance);
+    }
+}
+
+char cpd_instance_dsp_lock_memory(cpd_instance* instance)
+{
+    char state;
+    cpd_instance_lock(instance);
+    cpd_dsp_manager_set_locked(instance, 1);
+    state = cpd_memory_lock_owner(instance);
+    cpd_instance_unlock(instance);
+    return state;
+}
+
+void cpd_instance_dsp_unlock_memory(cpd_instance* instance)
+{
+    cpd_instance_lock(instance);
+    cpd_dsp_manager_unlock(instance);
+    cpd_instance_unlock(instance);
+}
+
+void cpd_instance_begin_batch(cpd_instance* instance)
+{
+    cpd_instance_lock(instance);
+    if(!instance->c_dsp->c_batch++)
+    {
+        // The chain isn't stopped, only the state is cleared so the loadings don't sort
+        // the chain and the previous chain is still performed during the batch.
+        instance->c_dsp->c_batch_state = pd_this->pd_dspstate;
+        pd_this->pd_dspstate = 0;
+    }
+    cpd_instance_unlock(instance);
+}
+
+void cpd_instance_end_batch(cpd_instance* instance)
+{
+    cpd_instance_lock(instance);
+    if(instance->c_dsp->c_batch && !--instance->c_dsp->c_batch)
+    {
+        if(cpd_patch_index_has_deferred(instance))
+        {
+            cpd_dsp_manager_stop_batch(instance);
+            cpd_patch_index_free_deferred(instance);
+        }
+        // Starting the DSP replaces the previous chain, so the chain is sorted once.
+        canvas_resume_dsp(instance->c_dsp->c_batch_state);
+    }
     cpd_instance_unlock(instance);
 }
 
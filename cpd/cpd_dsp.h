@@ -40,6 +40,40 @@ CPD_EXTERN void cpd_instance_dsp_prepare(cpd_instance* instance, const int nins,
 //! @param outputs The output samples matrix.
 CPD_EXTERN void cpd_instance_dsp_perform(cpd_instance* instance, int nsamples, const int nins, const cpd_sample** inputs, const int nouts, cpd_sample** outputs);
 
+//! @brief Prefaults and locks the memory used by the digital signal processing.
+//! @details Locks the memory allocated by Pure Data for the instance, the audio buffers,
+//! the objects, the signal buffers, the delay lines and the arrays of its patches, so the
+//! ticks don't page fault. The memory allocated afterward, by the loadings or by the
+//! resizings of the arrays, is locked too until the memory is unlocked. The memory is
+//! unlocked when the instance is freed or reset by its pool.
+//! @param instance The instance.
+//! @return 1 if all the memory has been locked, otherwise 0 but the memory is prefaulted.
+//! @see cpd_instance_dsp_unlock_memory
+CPD_EXTERN char cpd_instance_dsp_lock_memory(cpd_instance* instance);
+
+//! @brief Unlocks the memory used by the digital signal processing.
+//! @details The memory allocated afterward isn't locked anymore.
+//! @param instance The instance.
+//! @see cpd_instance_dsp_lock_memory
+CPD_EXTERN void cpd_instance_dsp_unlock_memory(cpd_instance* instance);
+
+//! @brief Begins a batch of changes of an instance.
+//! @details The sorting of the DSP chain is deferred until the end of the batch, so the
+//! loadings and the closings of the patches sort the DSP chain only once. The previous
+//! chain is still performed during the batch, the loaded patches are added to the chain
+//! and the closed patches are freed at the end of the batch. So closing a patch during a
+//! batch only takes effect at the end of the batch, the patch keeps sounding until then.
+//! The batches can be nested.
+//! @param instance The instance.
+//! @see cpd_instance_end_batch
+CPD_EXTERN void cpd_instance_begin_batch(cpd_instance* instance);
+
+//! @brief Ends a batch of changes of an instance.
+//! @details The DSP chain is sorted at the end of the outermost batch.
+//! @param instance The instance.
+//! @see cpd_instance_begin_batch
+CPD_EXTERN void cpd_instance_end_batch(cpd_instance* instance);
+
 //! @brief Releases the digital signal processing for an instance.
 //! @param instance The instance.
 CPD_EXTERN void cpd_instance_dsp_release(cpd_instance* instance);
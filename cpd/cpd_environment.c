@@ -21,6 +21,12 @@
 #include <string.h>
 #include <stdlib.h>
 #include <ctype.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <unistd.h>
+#endif
 
 // ==================================================================================== //
 //                                      GENERAL                                         //
@@ -67,18 +73,35 @@ void sys_mididevnumbertoname(int output, int devno, char *name, int namesize) {}
 //                                   IMPLEMENTATION                                     //
 // ==================================================================================== //
 
-static cpd_mutex c_mutex;
+#ifdef _MSC_VER
+#define CPD_THREAD_LOCAL __declspec(thread)
+#else
+#define CPD_THREAD_LOCAL __thread
+#endif
+
+static cpd_mutex                c_mutex;
+static CPD_THREAD_LOCAL char    c_locked = 0;
 
 extern void cpd_lock()
 {
     cpd_mutex_lock(&c_mutex);
+    c_locked = 1;
 }
 
 extern void cpd_unlock()
 {
+    c_locked = 0;
     cpd_mutex_unlock(&c_mutex);
 }
 
+//! @brief Checks if the environment is locked by the current thread.
+//! @details The lock isn't recursive, the methods that can be called from the hooks, while
+//! the environment is locked, use it to only lock the environment if it isn't already.
+extern char cpd_is_locked()
+{
+    return c_locked;
+}
+
 
 
 static t_sample*          c_sample_ins    = NULL;
@@ -95,8 +118,14 @@ cpd_symbol*        c_sym_vu            = NULL;
 cpd_symbol*        c_sym_cnv           = NULL;
 cpd_symbol*        c_sym_empty         = NULL;
 
+extern void* cpd_malloc(size_t size);
+extern void* cpd_calloc(size_t count, size_t size);
+extern void cpd_free(void* ptr);
 extern void cpd_print(const char* s);
 extern cpd_instance* c_current_instance;
+extern void cpd_patch_index_init();
+extern void cpd_patch_index_clear();
+static void cpd_path_cache_clear();
 
 // ==================================================================================== //
 //                                      INTERFACE                                       //
@@ -153,6 +182,7 @@ void cpd_init()
         c_sym_vu            = gensym("vu");
         c_sym_cnv           = gensym("cnv");
         c_sym_empty         = gensym("empty");
+        cpd_patch_index_init();
         
         bob_tilde_setup();
         bonk_tilde_setup();
@@ -182,6 +212,9 @@ void cpd_clear()
     {
         pdinstance_free(c_first_instance);
     }
+    cpd_patch_index_clear();
+    cpd_memory_collect();
+    cpd_path_cache_clear();
     cpd_mutex_destroy(&c_mutex);
 }
 
@@ -200,15 +233,195 @@ unsigned int cpd_version_getbug()
     return PD_BUGFIX_VERSION;
 }
 
+// ==================================================================================== //
+//                                      SEARCH PATH                                     //
+// ==================================================================================== //
+
+typedef struct cpd_path_entry
+{
+    char*       c_name;
+    const char* c_dir;
+} cpd_path_entry;
+
+static cpd_path_entry*  c_path_entries  = NULL;
+static size_t           c_path_size     = 0;
+static size_t           c_path_count    = 0;
+static char             c_path_valid    = 0;
+
+static size_t cpd_path_hash(const char* name)
+{
+    size_t h = 2166136261u;
+    while(*name)
+    {
+        h = (h ^ (unsigned char)(*name++)) * 16777619u;
+    }
+    return h;
+}
+
+static void cpd_path_cache_clear()
+{
+    size_t i;
+    for(i = 0; i < c_path_size; ++i)
+    {
+        cpd_free(c_path_entries[i].c_name);
+    }
+    cpd_free(c_path_entries);
+    c_path_entries  = NULL;
+    c_path_size     = 0;
+    c_path_count    = 0;
+    c_path_valid    = 0;
+}
+
+//! @brief Gets the entry of a file in the cache.
+//! @details The directory of the entry is NULL if the file is known to be missing.
+static cpd_path_entry* cpd_path_cache_get(const char* name)
+{
+    size_t i = cpd_path_hash(name) & (c_path_size - 1);
+    while(c_path_entries[i].c_name && strcmp(c_path_entries[i].c_name, name))
+    {
+        i = (i + 1) & (c_path_size - 1);
+    }
+    return c_path_entries+i;
+}
+
+static void cpd_path_cache_insert(const char* name, const char* dir)
+{
+    size_t i, oldsize = c_path_size;
+    cpd_path_entry* entry;
+    cpd_path_entry* old = c_path_entries;
+    if((c_path_count + 1) * 2 > c_path_size)
+    {
+        c_path_size    = c_path_size ? c_path_size * 2 : 256;
+        c_path_entries = (cpd_path_entry *)cpd_calloc(c_path_size, sizeof(cpd_path_entry));
+        if(!c_path_entries)
+        {
+            c_path_entries = old;
+            c_path_size    = oldsize;
+            return;
+        }
+        for(i = 0; i < oldsize; ++i)
+        {
+            if(old[i].c_name)
+            {
+                *cpd_path_cache_get(old[i].c_name) = old[i];
+            }
+        }
+        cpd_free(old);
+    }
+    // The directories are listed in the order of the search path so the first one wins.
+    entry = cpd_path_cache_get(name);
+    if(!entry->c_name)
+    {
+        entry->c_name = (char *)cpd_malloc(strlen(name) + 1);
+        if(entry->c_name)
+        {
+            strcpy(entry->c_name, name);
+            entry->c_dir = dir;
+            c_path_count++;
+        }
+    }
+}
+
+static void cpd_path_cache_list(const char* dir)
+{
+#ifdef _WIN32
+    char pattern[MAXPDSTRING];
+    WIN32_FIND_DATAA data;
+    HANDLE handle;
+    snprintf(pattern, MAXPDSTRING, "%s\\*", dir);
+    handle = FindFirstFileA(pattern, &data);
+    if(handle != INVALID_HANDLE_VALUE)
+    {
+        do
+        {
+            if(!(data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY))
+            {
+                cpd_path_cache_insert(data.cFileName, dir);
+            }
+        }
+        while(FindNextFileA(handle, &data));
+        FindClose(handle);
+    }
+#else
+    struct dirent* entry;
+    DIR* d = opendir(dir);
+    if(d)
+    {
+        while((entry = readdir(d)) != NULL)
+        {
+            if(entry->d_name[0] != '.')
+            {
+                cpd_path_cache_insert(entry->d_name, dir);
+            }
+        }
+        closedir(d);
+    }
+#endif
+}
+
+//! @brief Finds the directory of the search path that contains a file.
+//! @details The content of the directories of the search path is listed once and cached
+//! until the search path changes or cpd_searchpath_refresh is called. The method must be
+//! called while the environment is locked.
+//! @param name The name of the file.
+//! @param dir The directory of the file or NULL if the file is known to be missing.
+//! @return 1 if the file is in the cache, otherwise 0.
+extern char cpd_searchpath_find(const char* name, const char** dir)
+{
+    t_namelist* nl;
+    cpd_path_entry const* entry;
+    if(!c_path_valid)
+    {
+        cpd_path_cache_clear();
+        for(nl = sys_searchpath; nl; nl = nl->nl_next)
+        {
+            cpd_path_cache_list(nl->nl_string);
+        }
+        c_path_valid = 1;
+    }
+    entry = c_path_size ? cpd_path_cache_get(name) : NULL;
+    *dir  = entry ? entry->c_dir : NULL;
+    return (entry && entry->c_name) ? 1 : 0;
+}
+
+//! @brief Sets the directory of the search path that contains a file.
+//! @details The method is used to cache the result of the probing of the directories when
+//! the cache is stale, a NULL directory marks the file as missing so the directories are
+//! only probed once until the cache is refreshed. The directory must be a string of the
+//! search path. The method must be called while the environment is locked.
+extern void cpd_searchpath_set(const char* name, const char* dir)
+{
+    cpd_path_entry* entry;
+    cpd_path_cache_insert(name, dir);
+    entry = c_path_size ? cpd_path_cache_get(name) : NULL;
+    if(entry && entry->c_name)
+    {
+        entry->c_dir = dir;
+    }
+}
+
 void cpd_searchpath_clear()
 {
+    cpd_lock();
+    cpd_path_cache_clear();
     namelist_free(sys_searchpath);
     sys_searchpath = NULL;
+    cpd_unlock();
 }
 
 void cpd_searchpath_add(const char* path)
 {
+    cpd_lock();
+    c_path_valid = 0;
     sys_searchpath = namelist_append(sys_searchpath, path, 0);
+    cpd_unlock();
+}
+
+void cpd_searchpath_refresh()
+{
+    cpd_lock();
+    c_path_valid = 0;
+    cpd_unlock();
 }
 
 
@@ -32,6 +32,92 @@ CPD_EXTERN void cpd_clear();
 
 
 
+//! @brief The allocator used by cpd.
+//! @details The allocator is used for the memory owned by cpd, the instances, their queues,
+//! the messages and the patch managers, and for the memory allocated by Pure Data, the
+//! objects, the signal buffers, the delay lines and the arrays.
+//! @see cpd_memory_setallocator
+typedef struct cpd_allocator
+{
+    void* (*allocate)(size_t size);                 //!< @brief Allocates memory.
+    void* (*reallocate)(void* ptr, size_t size);    //!< @brief Reallocates memory.
+    void  (*deallocate)(void* ptr);                 //!< @brief Frees memory.
+} cpd_allocator;
+
+//! @brief Sets the allocator used by cpd.
+//! @details The allocator can be changed at any time, each block is reallocated and freed
+//! by the allocator that allocated it, so the allocator must stay valid while its blocks
+//! exist. A real-time allocator makes the messages sent to the instances and received from
+//! them real-time safe.
+//! @param allocator The allocator or NULL to use the default allocator.
+CPD_EXTERN void cpd_memory_setallocator(cpd_allocator const* allocator);
+
+//! @brief Gets the pool allocator bundled with cpd.
+//! @details The small blocks are served from size classes of up to 4 KB that are refilled
+//! by chunks of 64 KB and never returned to the system. The lists of free blocks are
+//! lock-free, so the allocations don't call the system and never wait for another thread
+//! once the pool is reserved. The pool is global, like the allocator, because the memory
+//! of an instance can be freed from another thread. The preparation of the instances
+//! reserves one chunk per class, but the blocks larger than 4 KB and the refills of the
+//! classes that run out of blocks still call malloc, so the pool should be reserved for
+//! the patches with cpd_memory_reservepool.
+//! @see cpd_memory_setallocator
+//! @see cpd_memory_reservepool
+CPD_EXTERN cpd_allocator const* cpd_memory_getpoolallocator();
+
+//! @brief Reserves the memory of the pool allocator bundled with cpd.
+//! @details Each size class of the pool holds at least the given size afterward. The
+//! method calls the system and shouldn't be called while performing.
+//! @param size The size in bytes reserved for each size class.
+//! @see cpd_memory_getpoolallocator
+CPD_EXTERN void cpd_memory_reservepool(size_t size);
+
+//! @brief Frees the memory released by the asynchronous closings.
+//! @details The large blocks of the patches closed with cpd_instance_patch_close_async and
+//! of the instances freed with cpd_instance_free_async are freed by this method, it should
+//! be called from a thread that isn't time critical.
+//! @return The number of blocks freed.
+CPD_EXTERN size_t cpd_memory_collect();
+
+//! @brief Gets the size of the memory locked by the instances.
+//! @details The memory locked with cpd_instance_dsp_lock_memory is counted, the mapped and
+//! locked chunks of the small blocks stay locked until the end of the process. The size is
+//! counted in pages, a page shared by several blocks is counted once.
+//! @see cpd_instance_dsp_lock_memory
+CPD_EXTERN size_t cpd_memory_getlockedsize();
+
+//! @brief Gets the number of allocations made while performing the DSP.
+//! @details Counts the memory allocated by cpd and by Pure Data on the threads that
+//! perform the DSP of the instances.
+CPD_EXTERN size_t cpd_memory_getperformallocations();
+
+//! @brief Locks all the memory mapped by the process.
+//! @details Locks the code and the static data of Pure Data and the memory already
+//! allocated, so the pages are never swapped out. The method isn't supported on Windows.
+//! @return 1 if the memory has been locked, otherwise 0.
+CPD_EXTERN char cpd_memory_lockall();
+
+//! @brief Sets the default huge page policy of the instances.
+//! @details The policy is copied by cpd_instance_config_init, so it only applies to the
+//! instances created afterward. If the policy is enabled, the blocks of at least 2 MB, the
+//! arrays and the delay lines, are backed with transparent huge pages when they are
+//! allocated or resized. The policy is only supported on Linux and has no
+//! effect elsewhere.
+//! @param state 1 to use huge pages, 0 to use the normal pages.
+CPD_EXTERN void cpd_memory_sethugepages(char state);
+
+//! @brief Gets the default huge page policy of the instances.
+CPD_EXTERN char cpd_memory_gethugepages();
+
+//! @brief Gets the size of the memory advised to be backed with huge pages.
+//! @details The memory is only advised and counted if the transparent huge pages are
+//! enabled on Linux, "always" or "madvise". The system can still back it with normal pages.
+//! @see cpd_memory_sethugepages
+CPD_EXTERN size_t cpd_memory_gethugepagessize();
+
+
+
+
 //! @brief Gets the major version of Pure Data.
 CPD_EXTERN unsigned int cpd_version_getmajor();
 
@@ -55,6 +141,12 @@ CPD_EXTERN void cpd_searchpath_clear();
 //! @param path The path to add.
 CPD_EXTERN void cpd_searchpath_add(const char* path);
 
+//! @brief Refreshes the cache of the search path of Pure Data.
+//! @details The content of the directories of the search path is cached to open the
+//! patches without probing each directory. The cache is refreshed when the search path
+//! changes, you should call this method if the content of the directories changed.
+CPD_EXTERN void cpd_searchpath_refresh();
+
 
 //! @}
 
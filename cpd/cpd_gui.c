@@ -13,12 +13,19 @@
 #include <assert.h>
 
 #include "cpd.h"
+#include "cpd_atomic.h"
 #include "../pd/src/m_pd.h"
 #include "../pd/src/g_canvas.h"
 #include "../pd/src/s_stuff.h"
 #include "../pd/src/m_imp.h"
 #include "../pd/src/g_all_guis.h"
+#include <stdlib.h>
+#include <stdint.h>
 
+extern void* cpd_malloc(size_t size);
+extern void* cpd_calloc(size_t count, size_t size);
+extern void* cpd_realloc(void* ptr, size_t size);
+extern void cpd_free(void* ptr);
 extern cpd_symbol*        c_sym_bng;
 extern cpd_symbol*        c_sym_hsl;
 extern cpd_symbol*        c_sym_vsl;
@@ -30,6 +37,59 @@ extern cpd_symbol*        c_sym_vu;
 extern cpd_symbol*        c_sym_cnv;
 extern cpd_symbol*        c_sym_empty;
 
+extern void cpd_lock();
+extern void cpd_unlock();
+extern char cpd_is_locked();
+extern void cpd_patch_gui_changed(cpd_gui* gui);
+
+#define CPD_GUI_NCLASSES 8
+
+typedef struct cpd_gui_methods
+{
+    t_class*        c_class;
+    t_bangmethod    c_bang;
+    t_floatmethod   c_float;
+    t_listmethod    c_list;
+    t_gotfn         c_set;
+    int             c_set_index;
+} cpd_gui_methods;
+
+// The methods are only wrapped while at least one patch tracks its guis.
+static cpd_gui_methods  c_gui_methods[CPD_GUI_NCLASSES];
+static size_t           c_gui_nmethods = 0;
+static size_t           c_gui_ntrackers = 0;
+
+typedef union cpd_gui_bits
+{
+    float   c_float;
+    int32_t c_int;
+} cpd_gui_bits;
+
+struct cpd_gui_slot
+{
+    cpd_gui*                c_gui;
+    struct cpd_gui_manager* c_manager;
+    cpd_atomic_int          c_value;
+    cpd_atomic_int          c_pending;
+    struct cpd_gui_slot*    c_next;
+    struct cpd_gui_slot*    c_ramp_next;
+    float                   c_current;
+    float                   c_target;
+    float                   c_step;
+    size_t                  c_nramps;
+    char                    c_ramping;
+};
+
+// The pending stack is pushed by the other threads, it doesn't share its cache line with
+// the members used by the audio thread.
+struct cpd_gui_manager
+{
+    cpd_atomic_ptr          c_pending;
+    char                    c_padding[CPD_CACHE_LINE - sizeof(cpd_atomic_ptr)];
+    cpd_atomic_int          c_nticks;
+    struct cpd_gui_slot*    c_ramps;
+};
+
 cpd_symbol* cpd_gui_get_label(cpd_gui const* gui)
 {
     return (c_sym_empty != gui->x_lab) ? gui->x_lab : &s_;
@@ -193,6 +253,415 @@ int cpd_gui_get_label_y(cpd_gui const* gui, cpd_patch const* patch)
     return cpd_object_get_y((cpd_object const*)gui, patch) + gui->x_ldy;
 }
 
+static void cpd_gui_get_state(cpd_gui* gui, cpd_gui_state* state)
+{
+    state->gui      = gui;
+    state->type     = cpd_gui_get_type(gui);
+    state->minimum  = 0.f;
+    state->maximum  = 0.f;
+    state->nsteps   = 0;
+    state->value    = 0.f;
+    switch(state->type)
+    {
+        case CPD_GUI_SLIDERH:
+            state->minimum  = ((t_hslider *)gui)->x_min;
+            state->maximum  = ((t_hslider *)gui)->x_max;
+            state->value    = ((t_hslider *)gui)->x_fval;
+            break;
+        case CPD_GUI_SLIDERV:
+            state->minimum  = ((t_vslider *)gui)->x_min;
+            state->maximum  = ((t_vslider *)gui)->x_max;
+            state->value    = ((t_vslider *)gui)->x_fval;
+            break;
+        case CPD_GUI_TOGGLE:
+            state->maximum  = 1.f;
+            state->nsteps   = 2;
+            state->value    = ((t_toggle *)gui)->x_on;
+            break;
+        case CPD_GUI_NUMBER:
+            state->minimum  = ((t_my_numbox *)gui)->x_min;
+            state->maximum  = ((t_my_numbox *)gui)->x_max;
+            state->value    = ((t_my_numbox *)gui)->x_val;
+            break;
+        case CPD_GUI_RADIOV:
+        case CPD_GUI_RADIOH:
+            state->maximum  = ((t_hdial *)gui)->x_number - 1;
+            state->nsteps   = ((t_hdial *)gui)->x_number;
+            state->value    = ((t_hdial *)gui)->x_on;
+            break;
+        default:
+            break;
+    }
+}
+
+size_t cpd_patch_snapshot_guis(cpd_patch const* patch, cpd_gui_state* states, size_t size)
+{
+    size_t count = 0;
+    cpd_object* object;
+    char const locked = cpd_is_locked();
+    if(!locked)
+    {
+        cpd_lock();
+    }
+    for(object = cpd_patch_get_first_object(patch); object; object = cpd_patch_get_next_object(patch, object))
+    {
+        if(cpd_object_is_gui(object))
+        {
+            if(states && count < size)
+            {
+                cpd_gui_get_state((cpd_gui *)object, states+count);
+            }
+            ++count;
+        }
+    }
+    if(!locked)
+    {
+        cpd_unlock();
+    }
+    return count;
+}
+
+// ==================================================================================== //
+//                                      TRACKING                                        //
+// ==================================================================================== //
+
+// Each wrapped class has its own wrappers, so the original methods are retrieved
+// directly by the index of the class.
+#define CPD_GUI_WRAPPERS(i)                                                             \
+static void cpd_gui_bang_tracked##i(t_pd* x)                                            \
+{                                                                                       \
+    c_gui_methods[i].c_bang(x);                                                         \
+    cpd_patch_gui_changed((cpd_gui *)x);                                                \
+}                                                                                       \
+static void cpd_gui_float_tracked##i(t_pd* x, t_float f)                                \
+{                                                                                       \
+    c_gui_methods[i].c_float(x, f);                                                     \
+    cpd_patch_gui_changed((cpd_gui *)x);                                                \
+}                                                                                       \
+static void cpd_gui_list_tracked##i(t_pd* x, t_symbol* s, int argc, t_atom* argv)       \
+{                                                                                       \
+    c_gui_methods[i].c_list(x, s, argc, argv);                                          \
+    cpd_patch_gui_changed((cpd_gui *)x);                                                \
+}                                                                                       \
+static void cpd_gui_set_tracked##i(t_pd* x, t_floatarg f)                               \
+{                                                                                       \
+    ((void (*)(t_pd*, t_floatarg))c_gui_methods[i].c_set)(x, f);                        \
+    cpd_patch_gui_changed((cpd_gui *)x);                                                \
+}
+
+CPD_GUI_WRAPPERS(0)
+CPD_GUI_WRAPPERS(1)
+CPD_GUI_WRAPPERS(2)
+CPD_GUI_WRAPPERS(3)
+CPD_GUI_WRAPPERS(4)
+CPD_GUI_WRAPPERS(5)
+CPD_GUI_WRAPPERS(6)
+CPD_GUI_WRAPPERS(7)
+
+#undef CPD_GUI_WRAPPERS
+
+static t_bangmethod const c_gui_bang_tracked[CPD_GUI_NCLASSES] =
+{
+    cpd_gui_bang_tracked0, cpd_gui_bang_tracked1, cpd_gui_bang_tracked2, cpd_gui_bang_tracked3,
+    cpd_gui_bang_tracked4, cpd_gui_bang_tracked5, cpd_gui_bang_tracked6, cpd_gui_bang_tracked7
+};
+
+static t_floatmethod const c_gui_float_tracked[CPD_GUI_NCLASSES] =
+{
+    cpd_gui_float_tracked0, cpd_gui_float_tracked1, cpd_gui_float_tracked2, cpd_gui_float_tracked3,
+    cpd_gui_float_tracked4, cpd_gui_float_tracked5, cpd_gui_float_tracked6, cpd_gui_float_tracked7
+};
+
+static t_listmethod const c_gui_list_tracked[CPD_GUI_NCLASSES] =
+{
+    cpd_gui_list_tracked0, cpd_gui_list_tracked1, cpd_gui_list_tracked2, cpd_gui_list_tracked3,
+    cpd_gui_list_tracked4, cpd_gui_list_tracked5, cpd_gui_list_tracked6, cpd_gui_list_tracked7
+};
+
+static t_gotfn const c_gui_set_tracked[CPD_GUI_NCLASSES] =
+{
+    (t_gotfn)cpd_gui_set_tracked0, (t_gotfn)cpd_gui_set_tracked1, (t_gotfn)cpd_gui_set_tracked2, (t_gotfn)cpd_gui_set_tracked3,
+    (t_gotfn)cpd_gui_set_tracked4, (t_gotfn)cpd_gui_set_tracked5, (t_gotfn)cpd_gui_set_tracked6, (t_gotfn)cpd_gui_set_tracked7
+};
+
+//! @brief Wraps the methods of the class of a gui that modify its value.
+//! @details Pd is used as an unmodified submodule, so the methods of the class are
+//! wrapped to notify the patch when the value changes. The method does nothing if the
+//! class is already wrapped.
+static void cpd_gui_wrap_class(cpd_gui const* gui)
+{
+    int i;
+    size_t j;
+    t_class* c = *((t_pd const *)gui);
+    cpd_gui_methods* methods;
+    for(j = 0; j < c_gui_nmethods; ++j)
+    {
+        if(c_gui_methods[j].c_class == c)
+        {
+            return;
+        }
+    }
+    if(c_gui_nmethods == CPD_GUI_NCLASSES || cpd_gui_get_type(gui) == CPD_GUI_PANEL)
+    {
+        return;
+    }
+    methods = c_gui_methods+c_gui_nmethods;
+    methods->c_class    = c;
+    methods->c_bang     = c->c_bangmethod;
+    methods->c_float    = c->c_floatmethod;
+    methods->c_list     = c->c_listmethod;
+    methods->c_set      = NULL;
+    methods->c_set_index = -1;
+    c->c_bangmethod     = c_gui_bang_tracked[c_gui_nmethods];
+    c->c_floatmethod    = c_gui_float_tracked[c_gui_nmethods];
+    c->c_listmethod     = c_gui_list_tracked[c_gui_nmethods];
+    for(i = 0; i < c->c_nmethods; ++i)
+    {
+        if(c->c_methods[i].me_name == gensym("set")
+           && c->c_methods[i].me_arg[0] == A_FLOAT && c->c_methods[i].me_arg[1] == A_NULL)
+        {
+            methods->c_set          = c->c_methods[i].me_fun;
+            methods->c_set_index    = i;
+            c->c_methods[i].me_fun  = c_gui_set_tracked[c_gui_nmethods];
+        }
+    }
+    c_gui_nmethods++;
+}
+
+//! @brief Starts the tracking of the guis of a patch.
+//! @details The method must be called while the environment is locked. The classes of
+//! the guis of the patch are wrapped if they aren't already.
+extern void cpd_gui_track_begin(cpd_patch const* patch)
+{
+    cpd_object* object;
+    for(object = cpd_patch_get_first_object(patch); object; object = cpd_patch_get_next_object(patch, object))
+    {
+        if(cpd_object_is_gui(object))
+        {
+            cpd_gui_wrap_class((cpd_gui *)object);
+        }
+    }
+    c_gui_ntrackers++;
+}
+
+//! @brief Stops the tracking of the guis of a patch.
+//! @details The method must be called while the environment is locked. The original
+//! methods of the classes are restored when no patch tracks its guis anymore.
+extern void cpd_gui_track_end()
+{
+    size_t i;
+    t_class* c;
+    if(c_gui_ntrackers && !--c_gui_ntrackers)
+    {
+        for(i = 0; i < c_gui_nmethods; ++i)
+        {
+            c = c_gui_methods[i].c_class;
+            c->c_bangmethod     = c_gui_methods[i].c_bang;
+            c->c_floatmethod    = c_gui_methods[i].c_float;
+            c->c_listmethod     = c_gui_methods[i].c_list;
+            if(c_gui_methods[i].c_set_index >= 0)
+            {
+                c->c_methods[c_gui_methods[i].c_set_index].me_fun = c_gui_methods[i].c_set;
+            }
+        }
+        c_gui_nmethods = 0;
+    }
+}
+
+// ==================================================================================== //
+//                                      VALUES                                          //
+// ==================================================================================== //
+
+extern size_t cpd_gui_manager_size()
+{
+    return sizeof(struct cpd_gui_manager);
+}
+
+extern void cpd_gui_manager_init(cpd_instance* instance, void* memory)
+{
+    instance->c_gui = (struct cpd_gui_manager *)memory;
+    if(instance->c_gui)
+    {
+        instance->c_gui->c_pending  = NULL;
+        instance->c_gui->c_nticks   = 0;
+        instance->c_gui->c_ramps    = NULL;
+    }
+}
+
+extern void cpd_gui_manager_clear(cpd_instance* instance)
+{
+    instance->c_gui = NULL;
+}
+
+static void cpd_gui_manager_push(struct cpd_gui_manager* manager, struct cpd_gui_slot* slot)
+{
+    void* head;
+    do
+    {
+        head = cpd_atomic_ptr_load(&manager->c_pending);
+        slot->c_next = (struct cpd_gui_slot *)head;
+    }
+    while(!cpd_atomic_ptr_compare_exchange(&manager->c_pending, head, slot));
+}
+
+//! @brief Applies the pending values and the ramps of the guis.
+//! @details The method is called by the processing at each tick.
+extern void cpd_gui_manager_perform(struct cpd_gui_manager* manager)
+{
+    cpd_gui_bits value;
+    cpd_guitype type;
+    struct cpd_gui_slot *slot, *next, **ramp;
+    size_t const nticks = (size_t)cpd_atomic_int_load(&manager->c_nticks);
+    slot = (struct cpd_gui_slot *)cpd_atomic_ptr_exchange(&manager->c_pending, NULL);
+    while(slot)
+    {
+        // The next slot must be read before the slot is released to the publishers.
+        next = slot->c_next;
+        cpd_atomic_int_store(&slot->c_pending, 0);
+        value.c_int = (int32_t)cpd_atomic_int_load(&slot->c_value);
+        type = cpd_gui_get_type(slot->c_gui);
+        if(nticks > 1 && (type == CPD_GUI_SLIDERH || type == CPD_GUI_SLIDERV || type == CPD_GUI_NUMBER))
+        {
+            if(!slot->c_ramping)
+            {
+                slot->c_current     = cpd_gui_get_value(slot->c_gui);
+                slot->c_ramp_next   = manager->c_ramps;
+                slot->c_ramping     = 1;
+                manager->c_ramps    = slot;
+            }
+            slot->c_target  = value.c_float;
+            slot->c_step    = (slot->c_target - slot->c_current) / (float)nticks;
+            slot->c_nramps  = nticks;
+        }
+        else
+        {
+            slot->c_nramps  = 0;
+            pd_float((t_pd *)slot->c_gui, value.c_float);
+        }
+        slot = next;
+    }
+    
+    ramp = &manager->c_ramps;
+    while(*ramp)
+    {
+        slot = *ramp;
+        if(slot->c_nramps)
+        {
+            slot->c_current = (--slot->c_nramps) ? slot->c_current + slot->c_step : slot->c_target;
+            pd_float((t_pd *)slot->c_gui, slot->c_current);
+        }
+        if(!slot->c_nramps)
+        {
+            slot->c_ramping = 0;
+            *ramp = slot->c_ramp_next;
+        }
+        else
+        {
+            ramp = &slot->c_ramp_next;
+        }
+    }
+}
+
+static int cpd_gui_slot_compare(void const* a, void const* b)
+{
+    cpd_gui const* ga = ((struct cpd_gui_slot const *)a)->c_gui;
+    cpd_gui const* gb = ((struct cpd_gui_slot const *)b)->c_gui;
+    return (ga < gb) ? -1 : ((ga > gb) ? 1 : 0);
+}
+
+//! @brief Allocates the value slots of the guis of a patch.
+//! @details The slots are sorted by gui so they can be retrieved with a binary search.
+//! The number of guis is retrieved even if the instance has no slots.
+extern struct cpd_gui_slot* cpd_gui_slots_new(cpd_instance* instance, cpd_patch const* patch, size_t* nguis, size_t* nslots)
+{
+    size_t count = 0;
+    cpd_object* object;
+    struct cpd_gui_slot* slots;
+    for(object = cpd_patch_get_first_object(patch); object; object = cpd_patch_get_next_object(patch, object))
+    {
+        count += cpd_object_is_gui(object) ? 1 : 0;
+    }
+    *nguis  = count;
+    *nslots = 0;
+    if(!count || !instance->c_gui)
+    {
+        return NULL;
+    }
+    slots = (struct cpd_gui_slot *)cpd_calloc(count, sizeof(struct cpd_gui_slot));
+    if(slots)
+    {
+        for(object = cpd_patch_get_first_object(patch); object; object = cpd_patch_get_next_object(patch, object))
+        {
+            if(cpd_object_is_gui(object))
+            {
+                slots[*nslots].c_gui        = (cpd_gui *)object;
+                slots[*nslots].c_manager    = instance->c_gui;
+                (*nslots)++;
+            }
+        }
+        qsort(slots, *nslots, sizeof(struct cpd_gui_slot), cpd_gui_slot_compare);
+    }
+    return slots;
+}
+
+//! @brief Frees the value slots of the guis of a patch.
+//! @details The method must be called while the instance is locked. The pending values
+//! and the ramps of the slots are discarded.
+extern void cpd_gui_slots_free(struct cpd_gui_slot* slots, size_t nslots)
+{
+    struct cpd_gui_slot *slot, *next, **ramp;
+    struct cpd_gui_manager* manager = nslots ? slots->c_manager : NULL;
+    if(manager)
+    {
+        slot = (struct cpd_gui_slot *)cpd_atomic_ptr_exchange(&manager->c_pending, NULL);
+        while(slot)
+        {
+            next = slot->c_next;
+            if(slot < slots || slot >= slots+nslots)
+            {
+                cpd_gui_manager_push(manager, slot);
+            }
+            slot = next;
+        }
+        ramp = &manager->c_ramps;
+        while(*ramp)
+        {
+            if(*ramp >= slots && *ramp < slots+nslots)
+            {
+                *ramp = (*ramp)->c_ramp_next;
+            }
+            else
+            {
+                ramp = &(*ramp)->c_ramp_next;
+            }
+        }
+    }
+    cpd_free(slots);
+}
+
+extern struct cpd_gui_slot* cpd_gui_slots_find(struct cpd_gui_slot* slots, size_t nslots, cpd_gui const* gui)
+{
+    struct cpd_gui_slot key;
+    key.c_gui = (cpd_gui *)gui;
+    return (struct cpd_gui_slot *)bsearch(&key, slots, nslots, sizeof(struct cpd_gui_slot), cpd_gui_slot_compare);
+}
+
+void cpd_gui_slot_set_value(cpd_gui_slot* slot, float value)
+{
+    cpd_gui_bits bits;
+    bits.c_float = value;
+    cpd_atomic_int_store(&slot->c_value, bits.c_int);
+    if(cpd_atomic_int_compare_exchange(&slot->c_pending, 0, 1))
+    {
+        cpd_gui_manager_push(slot->c_manager, slot);
+    }
+}
+
+void cpd_instance_gui_set_smoothing(cpd_instance* instance, size_t nticks)
+{
+    cpd_atomic_int_store(&instance->c_gui->c_nticks, (long)nticks);
+}
+
 
 
 
@@ -33,6 +33,23 @@ typedef enum
     CPD_GUI_PANEL         = 8  //!< @brief The gui is a panel.
 } cpd_guitype;
 
+//! @brief The state of a gui.
+//! @details The structure is used to retrieve the state of several guis at once.
+typedef struct cpd_gui_state
+{
+    cpd_gui*    gui;        //!< @brief The gui.
+    cpd_guitype type;       //!< @brief The type of the gui.
+    float       minimum;    //!< @brief The minimum value of the gui.
+    float       maximum;    //!< @brief The maximum value of the gui.
+    int         nsteps;     //!< @brief The number of steps of the gui.
+    float       value;      //!< @brief The current value of the gui.
+} cpd_gui_state;
+
+//! @brief The value slot of a gui.
+//! @details The slot is owned by the patch of the gui and remains valid until the patch
+//! is closed.
+typedef struct cpd_gui_slot cpd_gui_slot;
+
 
 //! @brief Gets the label of a gui.
 //! @param gui The gui.
@@ -86,6 +103,83 @@ CPD_EXTERN int cpd_gui_get_label_x(cpd_gui const* gui, cpd_patch const* patch);
 //! @return The y position of the label of the gui.
 CPD_EXTERN int cpd_gui_get_label_y(cpd_gui const* gui, cpd_patch const* patch);
 
+//! @brief Gets the states of all the guis of a patch.
+//! @details The method locks the environment once for all the guis, so the values can't
+//! be modified by the processing while they are retrieved. The method can also be called
+//! from a hook, while the environment is already locked by the thread. If the array is too
+//! small, only the first states are retrieved. You can pass a NULL array to only count the
+//! guis.
+//! @param patch The patch.
+//! @param states The array of states to fill or NULL.
+//! @param size The size of the array.
+//! @return The number of guis in the patch.
+CPD_EXTERN size_t cpd_patch_snapshot_guis(cpd_patch const* patch, cpd_gui_state* states, size_t size);
+
+//! @brief Gets the number of guis of a patch.
+//! @details The number is counted at the loading, even if the instance has no slots for
+//! the values of the guis, so the method doesn't lock the environment and can be used to size the arrays of the snapshots and of the collections
+//! of the changed guis.
+//! @param patch The patch.
+//! @return The number of guis in the patch.
+CPD_EXTERN size_t cpd_patch_get_number_of_guis(cpd_patch const* patch);
+
+//! @brief Enables or disables the tracking of the changes of the guis of a patch.
+//! @details When the tracking is enabled, the guis of the patch mark themselves as
+//! changed when their values are updated, so you can retrieve only the changed guis with
+//! cpd_patch_collect_changed_guis instead of polling all the values. The tracking is
+//! disabled by default. The gui classes of Pd are only wrapped while at least one patch
+//! tracks its guis, so the guis don't have any overhead otherwise. Like the snapshots,
+//! only the guis of the main canvas are tracked, not the ones of the subpatches.
+//! @param patch The patch.
+//! @param state 1 to enable the tracking, 0 to disable it.
+//! @return 1 if the state has been changed, otherwise 0.
+CPD_EXTERN char cpd_patch_track_guis(cpd_patch* patch, char state);
+
+//! @brief Collects the guis of a patch that changed since the last collection.
+//! @details The tracking of the patch must be enabled. The collected guis are unmarked.
+//! If the array is too small, the guis that can't be retrieved remain marked. You can
+//! pass a NULL array to only count the guis.
+//! @param patch The patch.
+//! @param guis The array of guis to fill or NULL.
+//! @param size The size of the array.
+//! @return The number of guis that changed.
+CPD_EXTERN size_t cpd_patch_collect_changed_guis(cpd_patch const* patch, cpd_gui** guis, size_t size);
+
+//! @brief Gets the value slot of a gui.
+//! @details The slot is retrieved once and can then be used to set the value of the gui
+//! without any lookup. The gui must be in the main canvas of a loaded patch.
+//! @param gui The gui.
+//! @return The slot of the gui or NULL.
+CPD_EXTERN cpd_gui_slot* cpd_gui_get_slot(cpd_gui const* gui);
+
+//! @brief Sets the value of a gui using its slot.
+//! @details The value is published in the slot with an atomic store and it is applied by
+//! the instance at the next tick of the processing as if the gui received a float. The
+//! method never waits for the processing and doesn't allocate memory, only the last value
+//! set before a tick is applied.
+//! @param slot The slot of the gui.
+//! @param value The value.
+CPD_EXTERN void cpd_gui_slot_set_value(cpd_gui_slot* slot, float value);
+
+//! @brief Sets the value of a gui.
+//! @details The method retrieves the slot of the gui and sets its value. The retrieval
+//! locks the index of the patches, so the slot should be retrieved once with
+//! cpd_gui_get_slot when the value is set often.
+//! @param gui The gui.
+//! @param value The value.
+//! @return 1 if the value has been published, otherwise 0.
+//! @see cpd_gui_get_slot, cpd_gui_slot_set_value
+CPD_EXTERN char cpd_gui_set_value(cpd_gui* gui, float value);
+
+//! @brief Sets the smoothing of the values of the guis of an instance.
+//! @details The values published with cpd_gui_slot_set_value or cpd_gui_set_value to the
+//! sliders and the number boxes are reached with a linear ramp over a number of ticks (blocks of 64 samples).
+//! The other guis are always set immediately. The default number of ticks is 0, that
+//! disables the smoothing.
+//! @param instance The instance.
+//! @param nticks The number of ticks of the ramps.
+CPD_EXTERN void cpd_instance_gui_set_smoothing(cpd_instance* instance, size_t nticks);
+
 //! @}
 
 
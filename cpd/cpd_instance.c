@@ -10,8 +10,15 @@
 
 
 #include "cpd_instance.h"
+#include "cpd_environment.h"
 #include "cpd_midi.h"
 #include "cpd_message.h"
+#include "cpd_patch.h"
+#include "cpd_post.h"
+#include "cpd_gui.h"
+#include "cpd_dsp.h"
+#include "cpd_mutex.h"
+#include "cpd_atomic.h"
 
 #include "../pd/src/m_pd.h"
 #include "../pd/src/s_stuff.h"
@@ -22,63 +29,304 @@
 #include <ctype.h>
 #include <stdlib.h>
 
+extern void* cpd_malloc(size_t size);
+extern void* cpd_calloc(size_t count, size_t size);
+extern void* cpd_realloc(void* ptr, size_t size);
+extern void cpd_free(void* ptr);
 extern void cpd_lock();
 extern void cpd_unlock();
+extern void cpd_instance_lock(cpd_instance* instance);
+extern void cpd_instance_unlock(cpd_instance* instance);
 
-extern void cpd_dsp_manager_init(cpd_instance* instance);
-extern void cpd_message_manager_init(cpd_instance* instance, size_t size);
-extern void cpd_midi_manager_init(cpd_instance* instance, size_t size);
-extern void cpd_post_manager_init(cpd_instance* instance);
+extern size_t cpd_dsp_manager_size();
+extern size_t cpd_message_manager_size();
+extern size_t cpd_midi_manager_size();
+extern size_t cpd_post_manager_size();
+extern size_t cpd_gui_manager_size();
+
+extern void cpd_dsp_manager_init(cpd_instance* instance, void* memory);
+extern void cpd_message_manager_init(cpd_instance* instance, void* memory, size_t size);
+extern void cpd_midi_manager_init(cpd_instance* instance, void* memory, size_t size);
+extern void cpd_post_manager_init(cpd_instance* instance, void* memory);
+extern void cpd_gui_manager_init(cpd_instance* instance, void* memory);
 
 extern void cpd_dsp_manager_clear(cpd_instance* instance);
 extern void cpd_message_manager_clear(cpd_instance* instance);
 extern void cpd_midi_manager_clear(cpd_instance* instance);
 extern void cpd_post_manager_clear(cpd_instance* instance);
+extern void cpd_gui_manager_clear(cpd_instance* instance);
+extern int cpd_post_manager_get_verbosity(struct cpd_post_manager const* manager);
+extern void cpd_message_manager_reset(cpd_instance* instance);
+extern void cpd_midi_manager_reset(cpd_instance* instance);
+extern void cpd_post_manager_reset(cpd_instance* instance);
+extern void cpd_patch_index_close_all(cpd_instance* instance);
+extern size_t cpd_patch_index_collect(cpd_instance* instance);
+extern void cpd_memory_defer(char state);
+extern void cpd_dsp_manager_set_hugepages(cpd_instance* instance, char state);
+extern void cpd_dsp_manager_set_locked(cpd_instance* instance, char state);
+extern char cpd_dsp_manager_get_locked(cpd_instance const* instance);
+extern void cpd_dsp_manager_unlock(cpd_instance* instance);
+extern char cpd_dsp_manager_get_hugepages(cpd_instance const* instance);
+extern void cpd_memory_setpolicy(void* owner, char lock, char hugepages);
+extern void cpd_memory_release_owner(void* owner);
+
+struct cpd_instance_pool
+{
+    cpd_mutex       c_mutex;
+    cpd_instance**  c_instances;
+    size_t          c_count;
+    size_t          c_capacity;
+    size_t          c_size;
+    int             c_ninputs;
+    int             c_noutputs;
+    int             c_samplerate;
+};
 
 cpd_instance* c_current_instance = NULL;
 
+// ==================================================================================== //
+//                                      MEMORY                                          //
+// ==================================================================================== //
+
+// The instance and its managers are allocated as one block aligned on a cache line, and
+// each part starts on its own cache line, so the data of an instance never shares a cache
+// line with the data of another instance or with another manager.
+
+static size_t cpd_instance_align(size_t size)
+{
+    return (size + CPD_CACHE_LINE - 1) & ~((size_t)CPD_CACHE_LINE - 1);
+}
+
+static void* cpd_instance_alloc(size_t size)
+{
+    char* aligned = NULL;
+    char* ptr = (char *)cpd_malloc(size + CPD_CACHE_LINE + sizeof(void *));
+    if(ptr)
+    {
+        aligned = (char *)cpd_instance_align((size_t)(ptr + sizeof(void *)));
+        ((void **)aligned)[-1] = ptr;
+    }
+    return aligned;
+}
+
+static void cpd_instance_dealloc(void* ptr)
+{
+    if(ptr)
+    {
+        cpd_free(((void **)ptr)[-1]);
+    }
+}
+
 cpd_instance* cpd_instance_new(size_t size)
 {
-    cpd_instance* instance = (cpd_instance *)malloc(size);
+    cpd_instance_config config;
+    cpd_instance_config_init(&config);
+    config.size = size;
+    return cpd_instance_new_ex(&config);
+}
+
+void cpd_instance_config_init(cpd_instance_config* config)
+{
+    config->size                = sizeof(cpd_instance);
+    config->message_capacity    = 512;
+    config->midi_capacity       = 512;
+    config->ninputs             = 0;
+    config->noutputs            = 0;
+    config->samplerate          = 0;
+    config->lock_memory         = 0;
+    config->huge_pages          = cpd_memory_gethugepages();
+}
+
+cpd_instance* cpd_instance_new_ex(cpd_instance_config const* config)
+{
+    size_t const sinstance = cpd_instance_align(config->size < sizeof(cpd_instance) ? sizeof(cpd_instance) : config->size);
+    size_t const sdsp = cpd_instance_align(cpd_dsp_manager_size());
+    size_t const smessage = cpd_instance_align(cpd_message_manager_size());
+    size_t const smidi = cpd_instance_align(cpd_midi_manager_size());
+    size_t const spost = cpd_instance_align(cpd_post_manager_size());
+    size_t const sgui = cpd_instance_align(cpd_gui_manager_size());
+    char* block = (char *)cpd_instance_alloc(sinstance + sdsp + smessage + smidi + spost + sgui);
+    cpd_instance* instance = (cpd_instance *)block;
     if(instance)
     {
         instance->c_internal = pdinstance_new();
-        cpd_dsp_manager_init(instance);
-        cpd_message_manager_init(instance, 512);
-        cpd_midi_manager_init(instance, 512);
-        cpd_post_manager_init(instance);
+        block += sinstance;
+        cpd_dsp_manager_init(instance, block);
+        block += sdsp;
+        cpd_message_manager_init(instance, block, config->message_capacity);
+        block += smessage;
+        cpd_midi_manager_init(instance, block, config->midi_capacity);
+        block += smidi;
+        cpd_post_manager_init(instance, block);
+        block += spost;
+        cpd_gui_manager_init(instance, block);
+        cpd_dsp_manager_set_hugepages(instance, config->huge_pages ? 1 : 0);
+        // The memory is locked before the preparation so the audio buffers and the
+        // patches loaded afterward are allocated locked.
+        if(config->lock_memory)
+        {
+            cpd_instance_dsp_lock_memory(instance);
+        }
+        if(config->samplerate > 0)
+        {
+            cpd_instance_dsp_prepare(instance, config->ninputs, config->noutputs, config->samplerate, DEFDACBLKSIZE);
+        }
     }
     return instance;
 }
 
-void cpd_instance_free(cpd_instance* instance)
+static void cpd_instance_delete(cpd_instance* instance, char async)
 {
-    cpd_lock();
-    if(c_current_instance == instance)
-    {
-        c_current_instance = NULL;
-    }
-    cpd_unlock();
+    cpd_instance_lock(instance);
+    cpd_memory_defer(async);
+    cpd_patch_index_close_all(instance);
+    cpd_memory_defer(0);
+    cpd_dsp_manager_unlock(instance);
+    cpd_memory_release_owner(instance);
+    c_current_instance = NULL;
+    cpd_instance_unlock(instance);
+    cpd_patch_index_collect(instance);
     cpd_midi_manager_clear(instance);
     cpd_message_manager_clear(instance);
     cpd_dsp_manager_clear(instance);
     cpd_post_manager_clear(instance);
-    free(instance);
+    cpd_gui_manager_clear(instance);
+    cpd_instance_dealloc(instance);
+}
+
+void cpd_instance_free(cpd_instance* instance)
+{
+    cpd_instance_delete(instance, 0);
+}
+
+void cpd_instance_free_async(cpd_instance* instance)
+{
+    cpd_instance_delete(instance, 1);
 }
 
 extern void cpd_instance_lock(cpd_instance* instance)
 {
     cpd_lock();
     c_current_instance = instance;
+    sys_verbose = cpd_post_manager_get_verbosity(instance->c_post);
     pd_setinstance(instance->c_internal);
+    cpd_memory_setpolicy(instance, cpd_dsp_manager_get_locked(instance), cpd_dsp_manager_get_hugepages(instance));
 }
 
 extern void cpd_instance_unlock(cpd_instance* instance)
 {
+    cpd_memory_setpolicy(NULL, 0, 0);
     cpd_unlock();
 }
 
 
+// ==================================================================================== //
+//                                      POOL                                            //
+// ==================================================================================== //
+
+static cpd_instance* cpd_instance_pool_create(cpd_instance_pool const* pool)
+{
+    cpd_instance_config config;
+    cpd_instance_config_init(&config);
+    config.size         = pool->c_size;
+    config.ninputs      = pool->c_ninputs;
+    config.noutputs     = pool->c_noutputs;
+    config.samplerate   = pool->c_samplerate;
+    return cpd_instance_new_ex(&config);
+}
+
+//! @brief Resets an instance released to a pool.
+//! @details The patches are closed, the batches are canceled, the memory is unlocked, the
+//! queues and the posts are emptied, the hooks and the settings are reset and the data of the user after the
+//! instance is zeroed, so nothing leaks to the next user of the instance.
+static void cpd_instance_reset(cpd_instance_pool const* pool, cpd_instance* instance)
+{
+    cpd_instance_patch_collect(instance);
+    cpd_instance_lock(instance);
+    cpd_patch_index_close_all(instance);
+    cpd_dsp_manager_unlock(instance);
+    cpd_message_manager_reset(instance);
+    cpd_midi_manager_reset(instance);
+    cpd_post_manager_reset(instance);
+    cpd_instance_unlock(instance);
+    cpd_instance_gui_set_smoothing(instance, 0);
+    if(pool->c_size > sizeof(cpd_instance))
+    {
+        memset((char *)instance + sizeof(cpd_instance), 0, pool->c_size - sizeof(cpd_instance));
+    }
+}
+
+cpd_instance_pool* cpd_instance_pool_new(size_t size, size_t count, int nins, int nouts, int samplerate)
+{
+    cpd_instance_pool* pool = (cpd_instance_pool *)cpd_malloc(sizeof(cpd_instance_pool));
+    if(pool)
+    {
+        pool->c_instances   = (cpd_instance **)cpd_malloc((count ? count : 1) * sizeof(cpd_instance *));
+        if(!pool->c_instances)
+        {
+            cpd_free(pool);
+            return NULL;
+        }
+        pool->c_count       = 0;
+        pool->c_capacity    = count;
+        pool->c_size        = size;
+        pool->c_ninputs     = nins;
+        pool->c_noutputs    = nouts;
+        pool->c_samplerate  = samplerate;
+        cpd_mutex_init(&pool->c_mutex);
+        while(pool->c_count < count)
+        {
+            pool->c_instances[pool->c_count] = cpd_instance_pool_create(pool);
+            if(!pool->c_instances[pool->c_count])
+            {
+                break;
+            }
+            pool->c_count++;
+        }
+    }
+    return pool;
+}
+
+void cpd_instance_pool_free(cpd_instance_pool* pool)
+{
+    while(pool->c_count)
+    {
+        cpd_instance_free(pool->c_instances[--pool->c_count]);
+    }
+    cpd_mutex_destroy(&pool->c_mutex);
+    cpd_free(pool->c_instances);
+    cpd_free(pool);
+}
+
+cpd_instance* cpd_instance_pool_acquire(cpd_instance_pool* pool)
+{
+    cpd_instance* instance = NULL;
+    cpd_mutex_lock(&pool->c_mutex);
+    if(pool->c_count)
+    {
+        instance = pool->c_instances[--pool->c_count];
+    }
+    cpd_mutex_unlock(&pool->c_mutex);
+    return instance ? instance : cpd_instance_pool_create(pool);
+}
+
+void cpd_instance_pool_release(cpd_instance_pool* pool, cpd_instance* instance)
+{
+    cpd_instance_reset(pool, instance);
+    cpd_mutex_lock(&pool->c_mutex);
+    if(pool->c_count < pool->c_capacity)
+    {
+        pool->c_instances[pool->c_count++] = instance;
+        instance = NULL;
+    }
+    cpd_mutex_unlock(&pool->c_mutex);
+    if(instance)
+    {
+        cpd_instance_free(instance);
+    }
+}
+
+
 
 
 
@@ -24,6 +24,8 @@ CPD_EXTERN_STRUCT cpd_dsp_manager;
 CPD_EXTERN_STRUCT cpd_message_manager;
 CPD_EXTERN_STRUCT cpd_midi_manager;
 CPD_EXTERN_STRUCT cpd_post_manager;
+CPD_EXTERN_STRUCT cpd_gui_manager;
+CPD_EXTERN_STRUCT cpd_instance_pool;
 
 //! @brief The instance is the main interface to communicate within the cpd environment
 //! @details The instance manages the posts to the console, the midi events, the messages
@@ -35,6 +37,7 @@ typedef struct cpd_instance
     struct cpd_message_manager* c_message;
     struct cpd_midi_manager*    c_midi;
     struct cpd_post_manager*    c_post;
+    struct cpd_gui_manager*     c_gui;
 }cpd_instance;
 
 
@@ -58,6 +61,36 @@ typedef struct cpd_instance
 //! @return A pointer to the initialized cpd_instance or NULL if the allocation failed.
 CPD_EXTERN cpd_instance* cpd_instance_new(size_t size);
 
+//! @brief The configuration of the creation of an instance.
+//! @see cpd_instance_config_init and cpd_instance_new_ex
+typedef struct cpd_instance_config
+{
+    size_t  size;               //!< @brief The size of memory of the instance in bytes.
+    size_t  message_capacity;   //!< @brief The initial capacity of the queue of messages.
+    size_t  midi_capacity;      //!< @brief The initial capacity of the queue of midi events.
+    int     ninputs;            //!< @brief The number of inputs.
+    int     noutputs;           //!< @brief The number of outputs.
+    int     samplerate;         //!< @brief The sample rate or 0 to prepare the instance later.
+    char    lock_memory;        //!< @brief Prefaults and locks the memory of the instance.
+    char    huge_pages;         //!< @brief Backs the large arrays with huge pages.
+}cpd_instance_config;
+
+//! @brief Initializes a configuration with the default values.
+//! @details The size is the size of a cpd_instance, the capacities of the queues are 512,
+//! the instance isn't prepared, its memory isn't locked and the huge page policy is the one
+//! of the environment.
+//! @param config The configuration.
+CPD_EXTERN void cpd_instance_config_init(cpd_instance_config* config);
+
+//! @brief Creates a new instance with a configuration.
+//! @details The queues are allocated with their capacities and if the sample rate is
+//! defined, the digital signal processing is prepared so the buffers of the channels are
+//! allocated once.
+//! @param config The configuration.
+//! @return A pointer to the initialized cpd_instance or NULL if the allocation failed.
+//! @see cpd_instance_new
+CPD_EXTERN cpd_instance* cpd_instance_new_ex(cpd_instance_config const* config);
+
 //! @brief Deletes an instance.
 //! @details You must first delete the members of your instance if need and therefater call
 //! this method to free the instance.
@@ -77,6 +110,48 @@ CPD_EXTERN cpd_instance* cpd_instance_new(size_t size);
 //! @param instance The pointer to the instance.
 CPD_EXTERN void cpd_instance_free(cpd_instance* instance);
 
+//! @brief Frees an instance and frees the memory of its patches later.
+//! @details The patches of the instance are closed immediately, but their large blocks of
+//! memory, like the arrays and the delay lines, are only freed by cpd_memory_collect, so
+//! the other instances aren't blocked for a long time.
+//! @param instance The pointer to the instance.
+//! @see cpd_instance_free
+CPD_EXTERN void cpd_instance_free_async(cpd_instance* instance);
+
+//! @brief The opaque type used for a pool of instances.
+//! @see cpd_instance_pool_new
+typedef struct cpd_instance_pool cpd_instance_pool;
+
+//! @brief Creates a pool of prepared instances.
+//! @details The instances are created and their digital signal processing is prepared
+//! once, so they can be acquired and released without allocation.
+//! @param size The size of memory of the instances in bytes.
+//! @param count The number of instances in the pool.
+//! @param nins The number of inputs of the instances.
+//! @param nouts The number of outputs of the instances.
+//! @param samplerate The sample rate of the instances.
+//! @return A pointer to the pool or NULL if the allocation failed.
+CPD_EXTERN cpd_instance_pool* cpd_instance_pool_new(size_t size, size_t count, int nins, int nouts, int samplerate);
+
+//! @brief Deletes a pool and its available instances.
+//! @details The acquired instances must be released before.
+//! @param pool The pool.
+CPD_EXTERN void cpd_instance_pool_free(cpd_instance_pool* pool);
+
+//! @brief Acquires an instance from a pool.
+//! @details If the pool is empty, a new instance is created and prepared.
+//! @param pool The pool.
+//! @return A pointer to the instance or NULL if the allocation failed.
+CPD_EXTERN cpd_instance* cpd_instance_pool_acquire(cpd_instance_pool* pool);
+
+//! @brief Releases an instance to a pool.
+//! @details The patches of the instance are closed, its batches are canceled, its ties are
+//! unbound, its queues and its posts are emptied, its hooks and settings are reset and the
+//! memory after the cpd_instance is zeroed. The instance is freed if the pool is full.
+//! @param pool The pool.
+//! @param instance The instance.
+CPD_EXTERN void cpd_instance_pool_release(cpd_instance_pool* pool, cpd_instance* instance);
+
 
 //! @}
 
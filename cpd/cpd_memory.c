@@ -0,0 +1,1261 @@
+/*
+// Copyright (c) 2015-2016 Pierre Guillot.
+// For information on usage and redistribution, and for a DISCLAIMER OF ALL
+// WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+*/
+
+// This part of the code is greatly inspired by Pure Data and libPD, and sometimes
+// directly copied. None of the authors of Pure Data and libPD is responsible for these
+// experiments but you must be aware of their unintended contribution.
+
+#include "cpd_environment.h"
+#include "cpd_atomic.h"
+
+#include "../pd/src/m_pd.h"
+#include <stdio.h>
+#include <string.h>
+#include <stddef.h>
+#include <stdlib.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+
+// ==================================================================================== //
+//                                   IMPLEMENTATION                                     //
+// ==================================================================================== //
+
+#ifdef _MSC_VER
+#define CPD_THREAD_LOCAL __declspec(thread)
+#else
+#define CPD_THREAD_LOCAL __thread
+#endif
+
+static const cpd_allocator          c_default_allocator = {malloc, realloc, free};
+static cpd_atomic_ptr               c_allocator = (void *)&c_default_allocator;
+static cpd_atomic_int               c_perform_allocations = 0;
+static cpd_atomic_int               c_hugepages = 0;
+static cpd_atomic_int64             c_locked_size = 0;
+static cpd_atomic_int               c_lock_failures = 0;
+static cpd_atomic_int64             c_advised_size = 0;
+static cpd_atomic_int               c_transparent = 0;
+static CPD_THREAD_LOCAL char        c_performing = 0;
+static CPD_THREAD_LOCAL char        c_deferring = 0;
+static CPD_THREAD_LOCAL char        c_locking = 0;
+static CPD_THREAD_LOCAL char        c_advising = 0;
+static CPD_THREAD_LOCAL void*       c_owner = NULL;
+static cpd_atomic_ptr               c_deferred = NULL;
+
+#define CPD_MEMORY_DEFERSIZE 4096
+#define CPD_MEMORY_HUGESIZE  2097152
+
+//! @brief Marks the current thread as performing the DSP of an instance.
+//! @details The allocations made by the thread are counted until the end of the perform.
+extern void cpd_memory_perform(char state)
+{
+    c_performing = state;
+}
+
+static void cpd_memory_count()
+{
+    if(c_performing)
+    {
+        cpd_atomic_int_fetch_add(&c_perform_allocations, 1);
+    }
+}
+
+//! @brief Defers the freeing of the large blocks of Pure Data on the current thread.
+//! @details The blocks are kept until cpd_memory_collect, so the arrays and the delay lines
+//! of a patch aren't freed while the instance is locked.
+extern void cpd_memory_defer(char state)
+{
+    c_deferring = state;
+}
+
+//! @brief Sets the memory policy of the instance locked on the current thread.
+//! @details If the locking is enabled, the blocks allocated by Pure Data are locked. If
+//! the huge pages are enabled, the blocks of at least 2 MB are mapped on their own pages
+//! and advised to be backed with huge pages, whether they are allocated or resized.
+extern void cpd_memory_setpolicy(void* owner, char lock, char hugepages)
+{
+    c_owner     = owner;
+    c_locking   = lock;
+    c_advising  = hugepages;
+}
+
+//! @brief Gets the number of times the memory couldn't be locked.
+extern size_t cpd_memory_getlockfailures()
+{
+    return (size_t)cpd_atomic_int_load(&c_lock_failures);
+}
+
+// The blocks allocated by cpd start with the allocator that allocated them, so they are
+// reallocated and freed by the same allocator even if the allocator of cpd has changed.
+
+typedef struct cpd_allocator_record
+{
+    cpd_allocator                   c_allocator;
+    struct cpd_allocator_record*    c_next;
+} cpd_allocator_record;
+
+static cpd_atomic_ptr c_allocators = NULL;
+
+typedef union cpd_allocation
+{
+    cpd_allocator const*    c_allocator;
+    double                  c_align[2];
+} cpd_allocation;
+
+extern void* cpd_malloc(size_t size)
+{
+    cpd_allocation* allocation;
+    cpd_allocator const* allocator = (cpd_allocator const *)cpd_atomic_ptr_load(&c_allocator);
+    cpd_memory_count();
+    allocation = (cpd_allocation *)allocator->allocate(sizeof(cpd_allocation) + size);
+    if(allocation)
+    {
+        allocation->c_allocator = allocator;
+        return allocation + 1;
+    }
+    return NULL;
+}
+
+extern void* cpd_calloc(size_t count, size_t size)
+{
+    void* ptr = cpd_malloc(count * size);
+    if(ptr)
+    {
+        memset(ptr, 0, count * size);
+    }
+    return ptr;
+}
+
+extern void* cpd_realloc(void* ptr, size_t size)
+{
+    cpd_allocation* allocation;
+    if(!ptr)
+    {
+        return cpd_malloc(size);
+    }
+    cpd_memory_count();
+    allocation = (cpd_allocation *)ptr - 1;
+    allocation = (cpd_allocation *)allocation->c_allocator->reallocate(allocation, sizeof(cpd_allocation) + size);
+    return allocation ? allocation + 1 : NULL;
+}
+
+extern void cpd_free(void* ptr)
+{
+    if(ptr)
+    {
+        cpd_allocation* allocation = (cpd_allocation *)ptr - 1;
+        allocation->c_allocator->deallocate(allocation);
+    }
+}
+
+static size_t cpd_memory_pagesize()
+{
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return (size_t)info.dwPageSize;
+#else
+    long const size = sysconf(_SC_PAGESIZE);
+    return size > 0 ? (size_t)size : 4096;
+#endif
+}
+
+//! @brief Touches the pages of memory, so they are mapped before the first use.
+static void cpd_memory_touch(void* ptr, size_t size)
+{
+    size_t i;
+    size_t const page = cpd_memory_pagesize();
+    for(i = 0; i < size; i += page)
+    {
+        volatile char* c = (volatile char *)ptr + i;
+        *c = *c;
+    }
+    *((volatile char *)ptr + size - 1) = *((volatile char *)ptr + size - 1);
+}
+
+//! @brief Locks pages of memory.
+//! @details The start must be aligned on a page. The locks don't nest, unlocking a page
+//! unlocks it for all the blocks that share it.
+static char cpd_memory_lock_system(char* start, size_t size)
+{
+#ifdef _WIN32
+    return VirtualLock(start, size) ? 1 : 0;
+#else
+    return mlock(start, size) ? 0 : 1;
+#endif
+}
+
+static void cpd_memory_unlock_system(char* start, size_t size)
+{
+#ifdef _WIN32
+    VirtualUnlock(start, size);
+#else
+    munlock(start, size);
+#endif
+}
+
+//! @brief Prefaults and locks memory that doesn't share its pages.
+//! @details The pages are touched even if the locking fails, so they are mapped before
+//! the first use.
+//! @return 1 if the memory has been locked, otherwise 0.
+static char cpd_memory_lock(void* ptr, size_t size)
+{
+    char* start;
+    size_t const page = cpd_memory_pagesize();
+    if(!ptr || !size)
+    {
+        return 1;
+    }
+    cpd_memory_touch(ptr, size);
+    start = (char *)((size_t)ptr & ~(page - 1));
+    return cpd_memory_lock_system(start, size + (size_t)((char *)ptr - start));
+}
+
+//! @brief Unlocks memory locked with cpd_memory_lock.
+static void cpd_memory_unlock(void* ptr, size_t size)
+{
+    char* start;
+    size_t const page = cpd_memory_pagesize();
+    if(!ptr || !size)
+    {
+        return;
+    }
+    start = (char *)((size_t)ptr & ~(page - 1));
+    cpd_memory_unlock_system(start, size + (size_t)((char *)ptr - start));
+}
+
+// ==================================================================================== //
+//                                          PAGES                                       //
+// ==================================================================================== //
+
+// The blocks allocated by the system share their pages with other blocks, that can belong
+// to another instance. Since the locks of the system don't nest, the pages locked in place
+// are counted in a hash table, a page is locked with its first block and unlocked with its
+// last one. The table uses linear probing and is only used while the environment is locked.
+
+typedef struct cpd_memory_page
+{
+    char*   c_address;
+    size_t  c_count;
+} cpd_memory_page;
+
+static cpd_memory_page* c_pages = NULL;
+static size_t           c_pages_size = 0;
+static size_t           c_pages_count = 0;
+
+static size_t cpd_memory_page_home(size_t size, char const* address)
+{
+    return ((size_t)address / cpd_memory_pagesize() * (size_t)2654435761u) & (size - 1);
+}
+
+static size_t cpd_memory_page_slot(cpd_memory_page const* pages, size_t size, char const* address)
+{
+    size_t i = cpd_memory_page_home(size, address);
+    while(pages[i].c_address && pages[i].c_address != address)
+    {
+        i = (i + 1) & (size - 1);
+    }
+    return i;
+}
+
+static char cpd_memory_page_grow()
+{
+    size_t i;
+    size_t const size = c_pages_size ? c_pages_size * 2 : 256;
+    cpd_memory_page* pages = (cpd_memory_page *)calloc(size, sizeof(cpd_memory_page));
+    if(!pages)
+    {
+        return 0;
+    }
+    for(i = 0; i < c_pages_size; ++i)
+    {
+        if(c_pages[i].c_address)
+        {
+            pages[cpd_memory_page_slot(pages, size, c_pages[i].c_address)] = c_pages[i];
+        }
+    }
+    free(c_pages);
+    c_pages      = pages;
+    c_pages_size = size;
+    return 1;
+}
+
+//! @brief Adds a reference to a page.
+//! @return The number of references of the page or 0 if the table can't grow.
+static size_t cpd_memory_page_retain(char* address)
+{
+    size_t i;
+    if((c_pages_count + 1) * 2 > c_pages_size && !cpd_memory_page_grow())
+    {
+        return 0;
+    }
+    i = cpd_memory_page_slot(c_pages, c_pages_size, address);
+    if(!c_pages[i].c_address)
+    {
+        c_pages[i].c_address = address;
+        c_pages[i].c_count   = 0;
+        ++c_pages_count;
+    }
+    return ++c_pages[i].c_count;
+}
+
+//! @brief Removes a reference to a page.
+//! @return The number of references left.
+static size_t cpd_memory_page_release(char* address)
+{
+    size_t i, j, k;
+    size_t const mask = c_pages_size - 1;
+    if(!c_pages_size)
+    {
+        return 0;
+    }
+    i = cpd_memory_page_slot(c_pages, c_pages_size, address);
+    if(!c_pages[i].c_address)
+    {
+        return 0;
+    }
+    if(--c_pages[i].c_count)
+    {
+        return c_pages[i].c_count;
+    }
+    // The pages that follow in the cluster are moved back, so they are still found.
+    c_pages[i].c_address = NULL;
+    --c_pages_count;
+    for(j = (i + 1) & mask; c_pages[j].c_address; j = (j + 1) & mask)
+    {
+        k = cpd_memory_page_home(c_pages_size, c_pages[j].c_address);
+        if((i <= j) ? (k <= i || k > j) : (k <= i && k > j))
+        {
+            c_pages[i] = c_pages[j];
+            c_pages[j].c_address = NULL;
+            i = j;
+        }
+    }
+    return 0;
+}
+
+//! @brief Releases the pages of a memory range and unlocks the ones that aren't used.
+static void cpd_memory_unlock_pages(void* ptr, size_t size)
+{
+    char* page;
+    size_t const psize = cpd_memory_pagesize();
+    char* const end = (char *)ptr + size;
+    for(page = (char *)((size_t)ptr & ~(psize - 1)); page < end; page += psize)
+    {
+        if(!cpd_memory_page_release(page))
+        {
+            cpd_memory_unlock_system(page, psize);
+            cpd_atomic_int64_fetch_add(&c_locked_size, -(long long)psize);
+        }
+    }
+}
+
+//! @brief Prefaults a memory range, retains its pages and locks the ones that weren't.
+//! @details If a page can't be locked, the pages retained before are released.
+//! @return 1 if the memory has been locked, otherwise 0.
+static char cpd_memory_lock_pages(void* ptr, size_t size)
+{
+    char* page;
+    char* first;
+    size_t count;
+    size_t const psize = cpd_memory_pagesize();
+    char* const end = (char *)ptr + size;
+    cpd_memory_touch(ptr, size);
+    first = (char *)((size_t)ptr & ~(psize - 1));
+    for(page = first; page < end; page += psize)
+    {
+        count = cpd_memory_page_retain(page);
+        if(count == 1 && !cpd_memory_lock_system(page, psize))
+        {
+            cpd_memory_page_release(page);
+            count = 0;
+        }
+        if(!count)
+        {
+            cpd_memory_unlock_pages(first, (size_t)(page - first));
+            return 0;
+        }
+        if(count == 1)
+        {
+            cpd_atomic_int64_fetch_add(&c_locked_size, (long long)psize);
+        }
+    }
+    return 1;
+}
+
+//! @brief Maps zeroed pages that aren't shared with the other blocks.
+static void* cpd_memory_map(size_t size)
+{
+#ifdef _WIN32
+    return VirtualAlloc(NULL, size, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+#else
+    void* ptr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    return ptr != MAP_FAILED ? ptr : NULL;
+#endif
+}
+
+static void cpd_memory_unmap(void* ptr, size_t size)
+{
+#ifdef _WIN32
+    (void)size;
+    VirtualFree(ptr, 0, MEM_RELEASE);
+#else
+    munmap(ptr, size);
+#endif
+}
+
+//! @brief Checks if the transparent huge pages can be used with the advice of the system.
+//! @details The state is read once from the system, only Linux is supported.
+static char cpd_memory_hugepages_enabled()
+{
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+    FILE* file;
+    size_t size;
+    char buffer[64];
+    int state = cpd_atomic_int_load(&c_transparent);
+    if(!state)
+    {
+        state = 1;
+        file  = fopen("/sys/kernel/mm/transparent_hugepage/enabled", "r");
+        if(file)
+        {
+            size = fread(buffer, 1, sizeof(buffer) - 1, file);
+            buffer[size] = '\0';
+            if(strstr(buffer, "[always]") || strstr(buffer, "[madvise]"))
+            {
+                state = 2;
+            }
+            fclose(file);
+        }
+        cpd_atomic_int_store(&c_transparent, state);
+    }
+    return state == 2 ? 1 : 0;
+#else
+    return 0;
+#endif
+}
+
+//! @brief Maps zeroed pages aligned on 2 MB, so the whole range can be backed with huge
+//! pages.
+//! @details The size must be a multiple of 2 MB. 2 MB more are mapped and the slack
+//! before and after the aligned range is unmapped.
+static void* cpd_memory_map_huge(size_t size)
+{
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+    char* aligned;
+    size_t head;
+    char* ptr = (char *)cpd_memory_map(size + CPD_MEMORY_HUGESIZE);
+    if(!ptr)
+    {
+        return NULL;
+    }
+    aligned = (char *)(((size_t)ptr + CPD_MEMORY_HUGESIZE - 1) & ~((size_t)CPD_MEMORY_HUGESIZE - 1));
+    head    = (size_t)(aligned - ptr);
+    if(head)
+    {
+        munmap(ptr, head);
+    }
+    munmap(aligned + size, CPD_MEMORY_HUGESIZE - head);
+    return aligned;
+#else
+    return cpd_memory_map(size);
+#endif
+}
+
+//! @brief Advises the system to back a large memory block with transparent huge pages.
+//! @details Only the blocks of at least 2 MB are advised and only on Linux, otherwise the
+//! memory is left as is.
+//! @return 1 if the advice has been given, otherwise 0.
+static char cpd_memory_hugepages(void* ptr, size_t size)
+{
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+    char* start;
+    char* end;
+    size_t const page = cpd_memory_pagesize();
+    if(!ptr || size < CPD_MEMORY_HUGESIZE)
+    {
+        return 0;
+    }
+    start = (char *)(((size_t)ptr + page - 1) & ~(page - 1));
+    end   = (char *)(((size_t)ptr + size) & ~(page - 1));
+    return (end > start && !madvise(start, (size_t)(end - start), MADV_HUGEPAGE)) ? 1 : 0;
+#else
+    (void)ptr;
+    (void)size;
+    return 0;
+#endif
+}
+
+// ==================================================================================== //
+//                                          POOL                                        //
+// ==================================================================================== //
+
+// A pool serves the small blocks from size classes of 16 bytes to 4 KB. The blocks are
+// carved from chunks of 64 KB that are kept until the end of the process, so the blocks
+// are reused without calling the system once the pool is reserved. Each class has its own
+// lock-free list of free blocks, the head of the list packs the index of the first block
+// with a tag incremented by each change, so a block popped and pushed back between the
+// read and the update of the head by another thread can't corrupt the list. The indices
+// are resolved with the table of the chunks of the class. The pools are global because
+// the allocator of cpd is global and because the memory of an instance can be freed by
+// another thread or another instance, by the asynchronous closings and the collection.
+// The bundled allocator uses a pool with chunks allocated by malloc and the locked blocks
+// of Pure Data use a pool with chunks mapped and locked, so they never share a page with
+// the memory that isn't locked.
+
+#define CPD_POOL_NCLASSES   9
+#define CPD_POOL_MINSIZE    16
+#define CPD_POOL_MAXSIZE    4096
+#define CPD_POOL_CHUNKSIZE  65536
+#define CPD_POOL_MAXCHUNKS  4096
+#define CPD_POOL_INDEXMASK  0xffffffffLL
+
+typedef union cpd_pool_header
+{
+    struct
+    {
+        unsigned int    c_class;
+        unsigned int    c_index;
+    }                   c_block;
+    double              c_align[2];
+} cpd_pool_header;
+
+typedef struct cpd_pool_class
+{
+    cpd_atomic_int64    c_head;
+    cpd_atomic_int      c_nchunks;
+    char                c_padding[CPD_CACHE_LINE - sizeof(cpd_atomic_int64) - sizeof(cpd_atomic_int)];
+    char* volatile      c_chunks[CPD_POOL_MAXCHUNKS];
+} cpd_pool_class;
+
+typedef struct cpd_pool
+{
+    cpd_pool_class  c_classes[CPD_POOL_NCLASSES];
+} cpd_pool;
+
+static cpd_pool c_pool;
+static cpd_pool c_pool_locked;
+
+static size_t cpd_pool_class_get(size_t size)
+{
+    size_t i = 0, csize = CPD_POOL_MINSIZE;
+    while(csize < size && i < CPD_POOL_NCLASSES)
+    {
+        csize <<= 1;
+        ++i;
+    }
+    return i;
+}
+
+static size_t cpd_pool_class_size(size_t index)
+{
+    return (size_t)CPD_POOL_MINSIZE << index;
+}
+
+//! @brief Gets a block of a class from its index.
+static char* cpd_pool_class_block(cpd_pool_class const* pclass, size_t index, unsigned int block)
+{
+    size_t const nblocks = CPD_POOL_CHUNKSIZE / cpd_pool_class_size(index);
+    return pclass->c_chunks[block / nblocks] + (block % nblocks) * cpd_pool_class_size(index);
+}
+
+//! @brief Replaces the first block of the list of a class and increments the tag.
+static char cpd_pool_class_update(cpd_pool_class* pclass, long long head, unsigned int first)
+{
+    long long const tag = (long long)(((unsigned long long)head >> 32) + 1) << 32;
+    return cpd_atomic_int64_compare_exchange(&pclass->c_head, head, tag | (long long)first);
+}
+
+static char* cpd_pool_chunk(cpd_pool const* pool)
+{
+    char* chunk;
+    if(pool != &c_pool_locked)
+    {
+        return (char *)malloc(CPD_POOL_CHUNKSIZE);
+    }
+    chunk = (char *)cpd_memory_map(CPD_POOL_CHUNKSIZE);
+    if(chunk)
+    {
+        if(cpd_memory_lock(chunk, CPD_POOL_CHUNKSIZE))
+        {
+            cpd_atomic_int64_fetch_add(&c_locked_size, CPD_POOL_CHUNKSIZE);
+        }
+        else
+        {
+            cpd_atomic_int_fetch_add(&c_lock_failures, 1);
+        }
+    }
+    return chunk;
+}
+
+//! @brief Adds a chunk to a class and pushes its blocks to the list.
+//! @details The blocks store the index of the next free block plus one, 0 ends the list.
+static char cpd_pool_refill(cpd_pool* pool, size_t index)
+{
+    unsigned int i;
+    long long head;
+    char* chunk;
+    cpd_pool_class* pclass = pool->c_classes + index;
+    size_t const bsize = cpd_pool_class_size(index);
+    unsigned int const nblocks = (unsigned int)(CPD_POOL_CHUNKSIZE / bsize);
+    long const slot = cpd_atomic_int_fetch_add(&pclass->c_nchunks, 1);
+    unsigned int const first = (unsigned int)slot * nblocks;
+    if(slot >= CPD_POOL_MAXCHUNKS)
+    {
+        cpd_atomic_int_fetch_add(&pclass->c_nchunks, -1);
+        return 0;
+    }
+    chunk = cpd_pool_chunk(pool);
+    if(!chunk)
+    {
+        return 0;
+    }
+    pclass->c_chunks[slot] = chunk;
+    for(i = 0; i < nblocks - 1; ++i)
+    {
+        *((unsigned int *)(chunk + i * bsize)) = first + i + 2;
+    }
+    do
+    {
+        head = cpd_atomic_int64_load(&pclass->c_head);
+        *((unsigned int *)(chunk + (nblocks - 1) * bsize)) = (unsigned int)(head & CPD_POOL_INDEXMASK);
+    }
+    while(!cpd_pool_class_update(pclass, head, first + 1));
+    return 1;
+}
+
+//! @brief Pops a block of a size class from a pool.
+//! @details The class is refilled if it is empty, the index of the block is returned so
+//! the block can be pushed back.
+static void* cpd_pool_pop(cpd_pool* pool, size_t index, unsigned int* block)
+{
+    long long head;
+    unsigned int first;
+    char* ptr;
+    cpd_pool_class* pclass = pool->c_classes + index;
+    for(;;)
+    {
+        head  = cpd_atomic_int64_load(&pclass->c_head);
+        first = (unsigned int)(head & CPD_POOL_INDEXMASK);
+        if(!first)
+        {
+            if(!cpd_pool_refill(pool, index))
+            {
+                return NULL;
+            }
+            continue;
+        }
+        // The next index can be overwritten by the owner of the block if it has been
+        // popped meanwhile, but then the tag has changed and the update fails.
+        ptr = cpd_pool_class_block(pclass, index, first - 1);
+        if(cpd_pool_class_update(pclass, head, *((unsigned int volatile *)ptr)))
+        {
+            *block = first - 1;
+            return ptr;
+        }
+    }
+}
+
+//! @brief Pushes a block of a size class back to a pool.
+static void cpd_pool_push(cpd_pool* pool, size_t index, unsigned int block)
+{
+    long long head;
+    cpd_pool_class* pclass = pool->c_classes + index;
+    char* ptr = cpd_pool_class_block(pclass, index, block);
+    do
+    {
+        head = cpd_atomic_int64_load(&pclass->c_head);
+        *((unsigned int *)ptr) = (unsigned int)(head & CPD_POOL_INDEXMASK);
+    }
+    while(!cpd_pool_class_update(pclass, head, block + 1));
+}
+
+//! @brief Makes sure that each class of a pool has a number of chunks.
+static void cpd_pool_reserve(cpd_pool* pool, size_t nchunks)
+{
+    size_t i;
+    for(i = 0; i < CPD_POOL_NCLASSES; ++i)
+    {
+        while((size_t)cpd_atomic_int_load(&pool->c_classes[i].c_nchunks) < nchunks)
+        {
+            if(!cpd_pool_refill(pool, i))
+            {
+                break;
+            }
+        }
+    }
+}
+
+static void* cpd_pool_allocate(size_t size)
+{
+    unsigned int block = 0;
+    size_t const index = cpd_pool_class_get(sizeof(cpd_pool_header) + size);
+    cpd_pool_header* header;
+    if(index == CPD_POOL_NCLASSES)
+    {
+        header = (cpd_pool_header *)malloc(sizeof(cpd_pool_header) + size);
+    }
+    else
+    {
+        header = (cpd_pool_header *)cpd_pool_pop(&c_pool, index, &block);
+    }
+    if(header)
+    {
+        header->c_block.c_class = (unsigned int)index;
+        header->c_block.c_index = block;
+        return header + 1;
+    }
+    return NULL;
+}
+
+static void cpd_pool_deallocate(void* ptr)
+{
+    cpd_pool_header* header = (cpd_pool_header *)ptr - 1;
+    if(!ptr)
+    {
+        return;
+    }
+    if(header->c_block.c_class == CPD_POOL_NCLASSES)
+    {
+        free(header);
+    }
+    else
+    {
+        cpd_pool_push(&c_pool, header->c_block.c_class, header->c_block.c_index);
+    }
+}
+
+static void* cpd_pool_reallocate(void* ptr, size_t size)
+{
+    void* ret;
+    size_t osize;
+    size_t const index = cpd_pool_class_get(sizeof(cpd_pool_header) + size);
+    cpd_pool_header* header = (cpd_pool_header *)ptr - 1;
+    if(!ptr)
+    {
+        return cpd_pool_allocate(size);
+    }
+    if(header->c_block.c_class == CPD_POOL_NCLASSES)
+    {
+        if(index == CPD_POOL_NCLASSES)
+        {
+            header = (cpd_pool_header *)realloc(header, sizeof(cpd_pool_header) + size);
+            return header ? header + 1 : NULL;
+        }
+        // The block is larger than the new size.
+        osize = size;
+    }
+    else
+    {
+        if(index == header->c_block.c_class)
+        {
+            return ptr;
+        }
+        osize = cpd_pool_class_size(header->c_block.c_class) - sizeof(cpd_pool_header);
+    }
+    ret = cpd_pool_allocate(size);
+    if(ret)
+    {
+        memcpy(ret, ptr, osize < size ? osize : size);
+        cpd_pool_deallocate(ptr);
+    }
+    return ret;
+}
+
+static const cpd_allocator c_pool_allocator = {cpd_pool_allocate, cpd_pool_reallocate, cpd_pool_deallocate};
+
+//! @brief Reserves the chunks of the pools used by the instance locked on the current
+//! thread before it performs.
+//! @details Each size class gets at least one chunk, so the first ticks don't refill the
+//! pools with the system.
+extern void cpd_memory_prepare()
+{
+    if(cpd_atomic_ptr_load(&c_allocator) == (void *)&c_pool_allocator)
+    {
+        cpd_pool_reserve(&c_pool, 1);
+    }
+    if(c_locking)
+    {
+        cpd_pool_reserve(&c_pool_locked, 1);
+    }
+}
+
+// ==================================================================================== //
+//                                          BLOCKS                                      //
+// ==================================================================================== //
+
+// The blocks of Pure Data start with a header that stores their size, their state and the
+// instance locked on the thread that allocated them. The blocks of the instances are
+// linked in a list, so the memory of an instance can be locked and unlocked afterward,
+// the list is only modified while the environment is locked. The blocks are allocated
+// with the allocator of cpd, unless the instance locks its memory. In this case, the small
+// blocks come from the pool of locked chunks and the larger blocks are mapped and locked
+// on their own pages. If the instance uses huge pages, the blocks of at least 2 MB are
+// mapped too, on 2 MB boundaries, and advised, so the arrays resized at runtime are advised
+// as well.
+
+#define CPD_MEMORY_MAPPED   1
+#define CPD_MEMORY_LOCKED   2
+#define CPD_MEMORY_POOLED   4
+#define CPD_MEMORY_ADVISED  8
+#define CPD_MEMORY_HUGE     16
+
+typedef union cpd_memory_header
+{
+    struct
+    {
+        size_t                      c_size;
+        size_t                      c_flags;
+        void*                       c_owner;
+        union cpd_memory_header*    c_next;
+        union cpd_memory_header*    c_previous;
+        size_t                      c_index;
+    }                               c_block;
+    double                          c_align[6];
+} cpd_memory_header;
+
+static cpd_memory_header* c_blocks = NULL;
+
+//! @brief Gets the size of the pages mapped for a block, the huge blocks are mapped on
+//! 2 MB boundaries.
+static size_t cpd_memory_mapsize(size_t size, size_t flags)
+{
+    size_t const page = (flags & CPD_MEMORY_HUGE) ? CPD_MEMORY_HUGESIZE : cpd_memory_pagesize();
+    return (sizeof(cpd_memory_header) + size + page - 1) & ~(page - 1);
+}
+
+static void cpd_memory_link(cpd_memory_header* header, void* owner)
+{
+    header->c_block.c_owner     = owner;
+    header->c_block.c_previous  = NULL;
+    header->c_block.c_next      = NULL;
+    if(owner)
+    {
+        header->c_block.c_next = c_blocks;
+        if(c_blocks)
+        {
+            c_blocks->c_block.c_previous = header;
+        }
+        c_blocks = header;
+    }
+}
+
+static void cpd_memory_unlink(cpd_memory_header* header)
+{
+    if(header->c_block.c_owner)
+    {
+        if(header->c_block.c_previous)
+        {
+            header->c_block.c_previous->c_block.c_next = header->c_block.c_next;
+        }
+        else
+        {
+            c_blocks = header->c_block.c_next;
+        }
+        if(header->c_block.c_next)
+        {
+            header->c_block.c_next->c_block.c_previous = header->c_block.c_previous;
+        }
+        header->c_block.c_owner = NULL;
+    }
+}
+
+//! @brief Locks a block, the mapped blocks own their pages, the other ones are locked in
+//! place and share their pages.
+static char cpd_memory_lock_header(cpd_memory_header* header)
+{
+    char state;
+    size_t const size = sizeof(cpd_memory_header) + header->c_block.c_size;
+    if(header->c_block.c_flags & CPD_MEMORY_LOCKED)
+    {
+        return 1;
+    }
+    if(header->c_block.c_flags & CPD_MEMORY_MAPPED)
+    {
+        state = cpd_memory_lock(header, cpd_memory_mapsize(header->c_block.c_size, header->c_block.c_flags));
+        if(state)
+        {
+            cpd_atomic_int64_fetch_add(&c_locked_size, (long long)cpd_memory_mapsize(header->c_block.c_size, header->c_block.c_flags));
+        }
+    }
+    else
+    {
+        state = cpd_memory_lock_pages(header, size);
+    }
+    if(!state)
+    {
+        cpd_atomic_int_fetch_add(&c_lock_failures, 1);
+        return 0;
+    }
+    header->c_block.c_flags |= CPD_MEMORY_LOCKED;
+    return 1;
+}
+
+//! @brief Unlocks a block that isn't in the pool of locked chunks.
+static void cpd_memory_unlock_header(cpd_memory_header* header)
+{
+    size_t const size = sizeof(cpd_memory_header) + header->c_block.c_size;
+    if((header->c_block.c_flags & CPD_MEMORY_POOLED) || !(header->c_block.c_flags & CPD_MEMORY_LOCKED))
+    {
+        return;
+    }
+    if(header->c_block.c_flags & CPD_MEMORY_MAPPED)
+    {
+        cpd_memory_unlock(header, cpd_memory_mapsize(header->c_block.c_size, header->c_block.c_flags));
+        cpd_atomic_int64_fetch_add(&c_locked_size, -(long long)cpd_memory_mapsize(header->c_block.c_size, header->c_block.c_flags));
+    }
+    else
+    {
+        cpd_memory_unlock_pages(header, size);
+    }
+    header->c_block.c_flags &= ~((size_t)CPD_MEMORY_LOCKED);
+}
+
+//! @brief Allocates a zeroed block of Pure Data with the policy of the current thread.
+static void* cpd_memory_allocate(size_t size)
+{
+    unsigned int block = 0;
+    cpd_memory_header* header;
+    size_t flags = CPD_MEMORY_MAPPED;
+    size_t const total = sizeof(cpd_memory_header) + size;
+    if(c_advising && size >= CPD_MEMORY_HUGESIZE && cpd_memory_hugepages_enabled())
+    {
+        cpd_memory_count();
+        flags |= CPD_MEMORY_HUGE;
+        header = (cpd_memory_header *)cpd_memory_map_huge(cpd_memory_mapsize(size, flags));
+        if(header)
+        {
+            header->c_block.c_flags = flags;
+            if(cpd_memory_hugepages(header, cpd_memory_mapsize(size, flags)))
+            {
+                header->c_block.c_flags |= CPD_MEMORY_ADVISED;
+                cpd_atomic_int64_fetch_add(&c_advised_size, (long long)cpd_memory_mapsize(size, flags));
+            }
+        }
+    }
+    else if((c_locking && total > CPD_POOL_MAXSIZE) || (c_advising && size >= CPD_MEMORY_HUGESIZE))
+    {
+        cpd_memory_count();
+        header = (cpd_memory_header *)cpd_memory_map(cpd_memory_mapsize(size, flags));
+        if(header)
+        {
+            header->c_block.c_flags = flags;
+        }
+    }
+    else if(c_locking)
+    {
+        cpd_memory_count();
+        header = (cpd_memory_header *)cpd_pool_pop(&c_pool_locked, cpd_pool_class_get(total), &block);
+        if(header)
+        {
+            memset(header, 0, total);
+            header->c_block.c_flags = CPD_MEMORY_POOLED | CPD_MEMORY_LOCKED;
+            header->c_block.c_index = block;
+        }
+    }
+    else
+    {
+        header = (cpd_memory_header *)cpd_calloc(1, total);
+    }
+    if(header)
+    {
+        header->c_block.c_size = size;
+        cpd_memory_link(header, c_owner);
+        if(c_locking && (header->c_block.c_flags & CPD_MEMORY_MAPPED))
+        {
+            cpd_memory_lock_header(header);
+        }
+        return header + 1;
+    }
+    return NULL;
+}
+
+//! @brief Unlinks and unlocks a block before it is freed.
+//! @details Must be called while the environment is locked.
+static void cpd_memory_release(cpd_memory_header* header)
+{
+    cpd_memory_unlink(header);
+    cpd_memory_unlock_header(header);
+}
+
+static void cpd_memory_deallocate(void* ptr)
+{
+    cpd_memory_header* header = (cpd_memory_header *)ptr - 1;
+    cpd_memory_release(header);
+    if(header->c_block.c_flags & CPD_MEMORY_POOLED)
+    {
+        cpd_pool_push(&c_pool_locked, cpd_pool_class_get(sizeof(cpd_memory_header) + header->c_block.c_size), (unsigned int)header->c_block.c_index);
+    }
+    else if(header->c_block.c_flags & CPD_MEMORY_MAPPED)
+    {
+        if(header->c_block.c_flags & CPD_MEMORY_ADVISED)
+        {
+            cpd_atomic_int64_fetch_add(&c_advised_size, -(long long)cpd_memory_mapsize(header->c_block.c_size, header->c_block.c_flags));
+        }
+        cpd_memory_unmap(header, cpd_memory_mapsize(header->c_block.c_size, header->c_block.c_flags));
+    }
+    else
+    {
+        cpd_free(header);
+    }
+}
+
+//! @brief Prefaults and locks the blocks of Pure Data allocated by an instance.
+//! @details Must be called while the environment is locked. The blocks allocated before
+//! are locked in place, the object, the signal buffers, the delay lines and the arrays.
+//! A page shared with the blocks of another instance stays locked until both are unlocked.
+//! @return 1 if all the blocks are locked, otherwise 0.
+extern char cpd_memory_lock_owner(void* owner)
+{
+    char state = 1;
+    cpd_memory_header* header;
+    for(header = c_blocks; header; header = header->c_block.c_next)
+    {
+        if(header->c_block.c_owner == owner)
+        {
+            state = cpd_memory_lock_header(header) && state;
+        }
+    }
+    return state;
+}
+
+//! @brief Unlocks the blocks of Pure Data allocated by an instance.
+//! @details Must be called while the environment is locked. The blocks of the pool of
+//! locked chunks stay locked.
+extern void cpd_memory_unlock_owner(void* owner)
+{
+    cpd_memory_header* header;
+    for(header = c_blocks; header; header = header->c_block.c_next)
+    {
+        if(header->c_block.c_owner == owner)
+        {
+            cpd_memory_unlock_header(header);
+        }
+    }
+}
+
+//! @brief Unlocks and forgets the blocks of Pure Data allocated by an instance.
+//! @details Must be called while the environment is locked, before the instance is freed.
+extern void cpd_memory_release_owner(void* owner)
+{
+    cpd_memory_header* next;
+    cpd_memory_header* header = c_blocks;
+    while(header)
+    {
+        next = header->c_block.c_next;
+        if(header->c_block.c_owner == owner)
+        {
+            cpd_memory_release(header);
+        }
+        header = next;
+    }
+}
+
+// ==================================================================================== //
+//                                      PURE DATA                                       //
+// ==================================================================================== //
+
+// The memory of Pure Data is allocated with the allocator of cpd, these methods replace
+// the ones of m_memory.c, so the objects, the signal buffers, the delay lines and the
+// arrays use the allocator, follow the policy of their instance and their allocations are
+// counted while performing the DSP.
+
+void *getbytes(size_t nbytes)
+{
+    void* ret = cpd_memory_allocate(nbytes < 1 ? 1 : nbytes);
+    if(!ret)
+    {
+        post("pd: getbytes() failed -- out of memory");
+    }
+    return ret;
+}
+
+void *getzbytes(size_t nbytes)
+{
+    return getbytes(nbytes);
+}
+
+void *copybytes(void *src, size_t nbytes)
+{
+    void* ret = getbytes(nbytes);
+    if(ret && nbytes)
+    {
+        memcpy(ret, src, nbytes);
+    }
+    return ret;
+}
+
+void *resizebytes(void *old, size_t oldsize, size_t newsize)
+{
+    void* ret = NULL;
+    void* owner;
+    size_t size;
+    cpd_memory_header* header;
+    (void)oldsize;
+    if(!old)
+    {
+        return getbytes(newsize);
+    }
+    if(newsize < 1)
+    {
+        newsize = 1;
+    }
+    header  = (cpd_memory_header *)old - 1;
+    size    = header->c_block.c_size;
+    owner   = header->c_block.c_owner;
+    if(!header->c_block.c_flags && !c_locking && !(c_advising && newsize >= CPD_MEMORY_HUGESIZE))
+    {
+        // The block is unlinked because the reallocation can move it.
+        cpd_memory_unlink(header);
+        header = (cpd_memory_header *)cpd_realloc(header, sizeof(cpd_memory_header) + newsize);
+        if(!header)
+        {
+            cpd_memory_link((cpd_memory_header *)old - 1, owner);
+        }
+        else
+        {
+            header->c_block.c_size = newsize;
+            cpd_memory_link(header, owner);
+            ret = header + 1;
+            if(newsize > size)
+            {
+                memset((char *)ret + size, 0, newsize - size);
+            }
+        }
+    }
+    else
+    {
+        ret = cpd_memory_allocate(newsize);
+        if(ret)
+        {
+            memcpy(ret, old, size < newsize ? size : newsize);
+            cpd_memory_deallocate(old);
+        }
+    }
+    if(!ret)
+    {
+        post("pd: resizebytes() failed -- out of memory");
+    }
+    return ret;
+}
+
+void freebytes(void *fatso, size_t nbytes)
+{
+    void* head;
+    cpd_memory_header* header = (cpd_memory_header *)fatso - 1;
+    (void)nbytes;
+    if(!fatso)
+    {
+        return;
+    }
+    if(c_deferring && header->c_block.c_size >= CPD_MEMORY_DEFERSIZE)
+    {
+        // The list of the blocks can't be modified by the collection.
+        cpd_memory_release(header);
+        do
+        {
+            head = cpd_atomic_ptr_load(&c_deferred);
+            *((void **)fatso) = head;
+        }
+        while(!cpd_atomic_ptr_compare_exchange(&c_deferred, head, fatso));
+        return;
+    }
+    cpd_memory_deallocate(fatso);
+}
+
+// ==================================================================================== //
+//                                      INTERFACE                                       //
+// ==================================================================================== //
+
+void cpd_memory_setallocator(cpd_allocator const* allocator)
+{
+    cpd_allocator_record* copy;
+    if(allocator == &c_pool_allocator)
+    {
+        cpd_atomic_ptr_store(&c_allocator, (void *)&c_pool_allocator);
+    }
+    else if(allocator && allocator->allocate && allocator->reallocate && allocator->deallocate)
+    {
+        // The copy is kept until the end of the process because the blocks refer to it.
+        copy = (cpd_allocator_record *)malloc(sizeof(cpd_allocator_record));
+        if(copy)
+        {
+            copy->c_allocator = *allocator;
+            do
+            {
+                copy->c_next = (cpd_allocator_record *)cpd_atomic_ptr_load(&c_allocators);
+            }
+            while(!cpd_atomic_ptr_compare_exchange(&c_allocators, copy->c_next, copy));
+            cpd_atomic_ptr_store(&c_allocator, &copy->c_allocator);
+        }
+    }
+    else
+    {
+        cpd_atomic_ptr_store(&c_allocator, (void *)&c_default_allocator);
+    }
+}
+
+size_t cpd_memory_getperformallocations()
+{
+    return (size_t)cpd_atomic_int_load(&c_perform_allocations);
+}
+
+char cpd_memory_lockall()
+{
+#ifdef _WIN32
+    return 0;
+#else
+    return mlockall(MCL_CURRENT) ? 0 : 1;
+#endif
+}
+
+void cpd_memory_sethugepages(char state)
+{
+    cpd_atomic_int_store(&c_hugepages, state ? 1 : 0);
+}
+
+char cpd_memory_gethugepages()
+{
+    return cpd_atomic_int_load(&c_hugepages) ? 1 : 0;
+}
+
+size_t cpd_memory_gethugepagessize()
+{
+    return (size_t)cpd_atomic_int64_load(&c_advised_size);
+}
+
+size_t cpd_memory_getlockedsize()
+{
+    return (size_t)cpd_atomic_int64_load(&c_locked_size);
+}
+
+cpd_allocator const* cpd_memory_getpoolallocator()
+{
+    return &c_pool_allocator;
+}
+
+void cpd_memory_reservepool(size_t size)
+{
+    cpd_pool_reserve(&c_pool, (size + CPD_POOL_CHUNKSIZE - 1) / CPD_POOL_CHUNKSIZE);
+}
+
+size_t cpd_memory_collect()
+{
+    void* next;
+    size_t count = 0;
+    void* ptr = cpd_atomic_ptr_exchange(&c_deferred, NULL);
+    while(ptr)
+    {
+        next = *((void **)ptr);
+        cpd_memory_deallocate(ptr);
+        ptr = next;
+        ++count;
+    }
+    return count;
+}
@@ -11,10 +11,15 @@
 
 #include "cpd_message.h"
 #include "cpd_mutex.h"
+#include "cpd_atomic.h"
 #include "../pd/src/m_pd.h"
 #include "../pd/src/s_stuff.h"
 #include <stdlib.h>
 
+extern void* cpd_malloc(size_t size);
+extern void* cpd_calloc(size_t count, size_t size);
+extern void* cpd_realloc(void* ptr, size_t size);
+extern void cpd_free(void* ptr);
 extern cpd_instance* c_current_instance;
 
 typedef struct cpd_receiver
@@ -26,15 +31,18 @@ typedef struct cpd_receiver
     struct cpd_receiver*    c_next;
 } cpd_receiver;
 
+// The fields used by the thread that performs the instance and the fields of the queue
+// written by the threads that send the messages are on separate cache lines.
 struct cpd_message_manager
 {
     cpd_instance*       c_instance;
     cpd_message_hook    c_hook;
+    cpd_receiver*       c_receivers;
+    char                c_padding[CPD_CACHE_LINE - sizeof(cpd_instance *) - sizeof(cpd_message_hook) - sizeof(cpd_receiver *)];
+    cpd_mutex           c_mutex;
     cpd_message*        c_buffer;
     size_t              c_size;
     size_t              c_pos;
-    cpd_mutex           c_mutex;
-    cpd_receiver*       c_receivers;
 };
 
 
@@ -52,7 +60,7 @@ static char cpd_message_manager_alloc(struct cpd_message_manager* manager, size_
     }
     if(manager->c_buffer && manager->c_size)
     {
-        temp = (cpd_message *)realloc(manager->c_buffer, sizeof(cpd_message) * newsize);
+        temp = (cpd_message *)cpd_realloc(manager->c_buffer, sizeof(cpd_message) * newsize);
         if(temp)
         {
             manager->c_buffer = temp;
@@ -62,7 +70,7 @@ static char cpd_message_manager_alloc(struct cpd_message_manager* manager, size_
     }
     else
     {
-        manager->c_buffer = (cpd_message *)malloc(sizeof(cpd_message) * newsize);
+        manager->c_buffer = (cpd_message *)cpd_malloc(sizeof(cpd_message) * newsize);
         if(manager->c_buffer)
         {
             manager->c_size = newsize;
@@ -96,7 +104,12 @@ static void receiver_free(cpd_receiver *x)
     pd_unbind((t_pd *)x, x->c_sym);
 }
 
-extern void cpd_message_manager_init(cpd_instance* instance, size_t size)
+extern size_t cpd_message_manager_size()
+{
+    return sizeof(struct cpd_message_manager);
+}
+
+extern void cpd_message_manager_init(cpd_instance* instance, void* memory, size_t size)
 {
     static t_class* c = NULL;
     if(!c)
@@ -112,7 +125,7 @@ extern void cpd_message_manager_init(cpd_instance* instance, size_t size)
         cpd_receiver_class = c;
     }
     
-    instance->c_message = (struct cpd_message_manager *)malloc(sizeof(struct cpd_message_manager));
+    instance->c_message = (struct cpd_message_manager *)memory;
     if(instance->c_message)
     {
         instance->c_message->c_hook     = NULL;
@@ -136,13 +149,37 @@ extern void cpd_message_manager_clear(cpd_instance* instance)
     }
     if(instance->c_message->c_buffer && instance->c_message->c_size)
     {
-        free(instance->c_message->c_buffer);
+        cpd_free(instance->c_message->c_buffer);
     }
     instance->c_message->c_buffer = NULL;
     instance->c_message->c_size = 0;
     instance->c_message->c_pos  = 0;
     cpd_mutex_destroy(&(instance->c_message->c_mutex));
-    free(instance->c_message);
+    instance->c_message = NULL;
+}
+
+extern void cpd_message_manager_reset(cpd_instance* instance)
+{
+    size_t i;
+    cpd_receiver* next = NULL;
+    struct cpd_message_manager* manager = instance->c_message;
+    while(manager->c_receivers)
+    {
+        next = manager->c_receivers->c_next;
+        pd_free((t_pd *)manager->c_receivers);
+        manager->c_receivers = next;
+    }
+    cpd_mutex_lock(&(manager->c_mutex));
+    for(i = 0; i < manager->c_pos; ++i)
+    {
+        if(manager->c_buffer[i].list.size && manager->c_buffer[i].list.vector)
+        {
+            cpd_list_clear(&manager->c_buffer[i].list);
+        }
+    }
+    manager->c_pos  = 0;
+    manager->c_hook = NULL;
+    cpd_mutex_unlock(&(manager->c_mutex));
 }
 
 extern void cpd_message_manager_perform(struct cpd_message_manager* manager)
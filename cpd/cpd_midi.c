@@ -11,20 +11,28 @@
 
 #include "cpd_midi.h"
 #include "cpd_mutex.h"
+#include "cpd_atomic.h"
 #include "../pd/src/m_pd.h"
 #include "../pd/src/s_stuff.h"
 #include <stdlib.h>
 
 
+extern void* cpd_malloc(size_t size);
+extern void* cpd_calloc(size_t count, size_t size);
+extern void* cpd_realloc(void* ptr, size_t size);
+extern void cpd_free(void* ptr);
 extern cpd_instance* c_current_instance;
 
+// The hook used by the thread that performs the instance and the fields of the queue
+// written by the threads that send the events are on separate cache lines.
 struct cpd_midi_manager
 {
     cpd_midi_hook   c_hook;
+    char            c_padding[CPD_CACHE_LINE - sizeof(cpd_midi_hook)];
+    cpd_mutex       c_mutex;
     cpd_midi_event* c_buffer;
     size_t          c_size;
     size_t          c_pos;
-    cpd_mutex       c_mutex;
 };
 
 // ==================================================================================== //
@@ -40,7 +48,7 @@ static char cpd_midi_manager_alloc(struct cpd_midi_manager* manager, size_t news
     }
     if(manager->c_buffer && manager->c_size)
     {
-        temp = (cpd_midi_event *)realloc(manager->c_buffer, sizeof(cpd_midi_event) * newsize);
+        temp = (cpd_midi_event *)cpd_realloc(manager->c_buffer, sizeof(cpd_midi_event) * newsize);
         if(temp)
         {
             manager->c_buffer = temp;
@@ -50,7 +58,7 @@ static char cpd_midi_manager_alloc(struct cpd_midi_manager* manager, size_t news
     }
     else
     {
-        manager->c_buffer = (cpd_midi_event *)malloc(sizeof(cpd_midi_event) * newsize);
+        manager->c_buffer = (cpd_midi_event *)cpd_malloc(sizeof(cpd_midi_event) * newsize);
         if(manager->c_buffer)
         {
             manager->c_size = newsize;
@@ -64,9 +72,14 @@ static char cpd_midi_manager_alloc(struct cpd_midi_manager* manager, size_t news
 //                                      INTERNAL                                        //
 // ==================================================================================== //
 
-extern void cpd_midi_manager_init(cpd_instance* instance, size_t size)
+extern size_t cpd_midi_manager_size()
+{
+    return sizeof(struct cpd_midi_manager);
+}
+
+extern void cpd_midi_manager_init(cpd_instance* instance, void* memory, size_t size)
 {
-    instance->c_midi = (struct cpd_midi_manager *)malloc(sizeof(struct cpd_midi_manager));
+    instance->c_midi = (struct cpd_midi_manager *)memory;
     if(instance->c_midi)
     {
         instance->c_midi->c_hook     = NULL;
@@ -82,13 +95,21 @@ extern void cpd_midi_manager_clear(cpd_instance* instance)
 {
     if(instance->c_midi->c_buffer && instance->c_midi->c_size)
     {
-        free(instance->c_midi->c_buffer);
+        cpd_free(instance->c_midi->c_buffer);
     }
     instance->c_midi->c_buffer = NULL;
     instance->c_midi->c_size = 0;
     instance->c_midi->c_pos  = 0;
     cpd_mutex_destroy(&(instance->c_midi->c_mutex));
-    free(instance->c_midi);
+    instance->c_midi = NULL;
+}
+
+extern void cpd_midi_manager_reset(cpd_instance* instance)
+{
+    cpd_mutex_lock(&(instance->c_midi->c_mutex));
+    instance->c_midi->c_pos  = 0;
+    instance->c_midi->c_hook = NULL;
+    cpd_mutex_unlock(&(instance->c_midi->c_mutex));
 }
 
 extern void cpd_midi_manager_perform(struct cpd_midi_manager* manager)
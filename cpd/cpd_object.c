@@ -46,7 +46,15 @@ void cpd_object_get_text(cpd_object const* object, int* size, char** text)
     binbuf_gettext(((t_text *)(object))->te_binbuf, text, size);
 }
 
-static void cpd_object_get_bounds(cpd_object const* object, cpd_patch const* patch, int* x, int* y, int* width, int* height)
+void cpd_object_free_text(int size, char* text)
+{
+    if(text)
+    {
+        freebytes(text, (size_t)size);
+    }
+}
+
+void cpd_object_get_bounds(cpd_object const* object, cpd_patch const* patch, int* x, int* y, int* width, int* height)
 {
     struct _widgetbehavior const* wb = cpd_object_get_widget(object);
     if(cpd_object_is_patchable(object) && wb && wb->w_getrectfn)
@@ -25,12 +25,32 @@
 //! @return The name of the object.
 CPD_EXTERN cpd_symbol* cpd_object_get_name(cpd_object const* object);
 
-//! @brief Gets the name of an object.
+//! @brief Gets the text of an object.
+//! @details The text is allocated by Pure Data and isn't null terminated, it must be
+//! freed with cpd_object_free_text.
 //! @param object The object.
 //! @param size The size of the c-string character that will be allocated.
 //! @param text The c-string character that will be allocated.
+//! @see cpd_object_free_text
 CPD_EXTERN void cpd_object_get_text(cpd_object const* object, int* size, char** text);
 
+//! @brief Frees the text of an object.
+//! @param size The size of the c-string character.
+//! @param text The c-string character.
+//! @see cpd_object_get_text
+CPD_EXTERN void cpd_object_free_text(int size, char* text);
+
+//! @brief Gets the bounds of an object within a patch.
+//! @details Prefer this method to retrieving the position and the size separately, the
+//! bounds are computed only once.
+//! @param object The object.
+//! @param patch The patch.
+//! @param x The x position of the object.
+//! @param y The y position of the object.
+//! @param width The width of the object.
+//! @param height The height of the object.
+CPD_EXTERN void cpd_object_get_bounds(cpd_object const* object, cpd_patch const* patch, int* x, int* y, int* width, int* height);
+
 //! @brief Gets the x position of an object within a patch.
 //! @param object The object.
 //! @param patch The patch.
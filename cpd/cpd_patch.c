@@ -9,53 +9,1386 @@
 // experiments but you must be aware of their unintended contribution.
 
 #include "cpd_patch.h"
+#include "cpd_object.h"
+#include "cpd_gui.h"
+#include "cpd_mutex.h"
 #include "../pd/src/m_pd.h"
 #include "../pd/src/m_imp.h"
 #include "../pd/src/s_stuff.h"
 #include "../pd/src/g_canvas.h"
 #include "../pd/src/g_all_guis.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
 
+extern void* cpd_malloc(size_t size);
+extern void* cpd_calloc(size_t count, size_t size);
+extern void* cpd_realloc(void* ptr, size_t size);
+extern void cpd_free(void* ptr);
 extern void cpd_instance_lock(cpd_instance* instance);
 extern void cpd_instance_unlock(cpd_instance* instance);
+extern void cpd_lock();
+extern void cpd_unlock();
+extern char cpd_is_locked();
+extern char cpd_searchpath_find(const char* name, const char** dir);
+extern void cpd_searchpath_set(const char* name, const char* dir);
+extern void cpd_gui_track_begin(cpd_patch const* patch);
+extern void cpd_gui_track_end();
+extern struct cpd_gui_slot* cpd_gui_slots_new(cpd_instance* instance, cpd_patch const* patch, size_t* nguis, size_t* nslots);
+extern void cpd_gui_slots_free(struct cpd_gui_slot* slots, size_t nslots);
+extern void cpd_memory_defer(char state);
+extern struct cpd_gui_slot* cpd_gui_slots_find(struct cpd_gui_slot* slots, size_t nslots, cpd_gui const* gui);
+extern char cpd_dsp_manager_in_batch(cpd_instance const* instance);
+extern void cpd_dsp_manager_cancel_batch(cpd_instance* instance);
+
+#define CPD_PATCH_NBUCKETS 64
+#define CPD_BINARY_VERSION 1
+
+typedef enum
+{
+    CPD_INDEX_RECEIVE   = 0,
+    CPD_INDEX_SEND      = 1,
+    CPD_INDEX_NAME      = 2
+} cpd_indextype;
+
+//! @brief The parsed content of a patch shared by the patch files and the patches.
+typedef struct cpd_patch_source
+{
+    t_binbuf*   c_binbuf;
+    size_t      c_refs;
+} cpd_patch_source;
+
+//! @brief The objects of a patch that share a key, a name or a tie.
+typedef struct cpd_index_entry
+{
+    void const*     c_key;
+    cpd_indextype   c_type;
+    cpd_object**    c_objects;
+    size_t          c_nobjects;
+    size_t          c_size;
+} cpd_index_entry;
+
+struct cpd_patch_index
+{
+    cpd_patch*                  c_patch;
+    cpd_index_entry*            c_entries;
+    size_t                      c_size;
+    size_t                      c_count;
+    cpd_gui**                   c_changed;
+    size_t                      c_changed_size;
+    size_t                      c_changed_count;
+    char                        c_changed_all;
+    struct cpd_gui_slot*        c_slots;
+    size_t                      c_nslots;
+    size_t                      c_nguis;
+    cpd_patch_source*           c_source;
+    cpd_instance*               c_instance;
+    char                        c_async;
+    struct cpd_patch_index*   c_next;
+};
+
+// The registry of the indices is only modified while the environment and the mutex are
+// locked, so the methods called by Pd (while the environment is locked) can read it
+// without the mutex. The list of the patches closed asynchronously is also modified by
+// cpd_patch_index_collect with the mutex alone, so it is always accessed with the mutex.
+// The list of the patches closed during a batch is only used while the environment is
+// locked.
+static cpd_mutex                    c_patch_mutex;
+static struct cpd_patch_index*    c_patch_indices[CPD_PATCH_NBUCKETS];
+static struct cpd_patch_index*    c_patch_closing;
+static struct cpd_patch_index*    c_patch_deferred;
+static t_symbol*                    c_sym_r;
+static t_symbol*                    c_sym_receive;
+static t_symbol*                    c_sym_s;
+static t_symbol*                    c_sym_send;
+
+//! @brief The parsed content of a patch file.
+typedef struct cpd_patch_file
+{
+    char*                   c_path;
+    time_t                  c_mtime;
+    size_t                  c_size;
+    cpd_patch_source*       c_source;
+    struct cpd_patch_file*  c_next;
+} cpd_patch_file;
+
+// The cache of the patch files is shared by all the instances and is only accessed while
+// the environment is locked.
+static cpd_patch_file*              c_patch_files;
+
+// ==================================================================================== //
+//                                      SOURCES                                         //
+// ==================================================================================== //
+
+// The sources are only retained and released while the environment is locked.
+
+static cpd_patch_source* cpd_patch_source_new()
+{
+    cpd_patch_source* source = (cpd_patch_source *)cpd_malloc(sizeof(cpd_patch_source));
+    if(source)
+    {
+        source->c_binbuf = binbuf_new();
+        source->c_refs   = 1;
+        if(!source->c_binbuf)
+        {
+            cpd_free(source);
+            source = NULL;
+        }
+    }
+    return source;
+}
+
+static cpd_patch_source* cpd_patch_source_retain(cpd_patch_source* source)
+{
+    if(source)
+    {
+        source->c_refs++;
+    }
+    return source;
+}
+
+static void cpd_patch_source_release(cpd_patch_source* source)
+{
+    if(source && !--source->c_refs)
+    {
+        binbuf_free(source->c_binbuf);
+        cpd_free(source);
+    }
+}
+
+// ==================================================================================== //
+//                                      INDEX                                           //
+// ==================================================================================== //
+
+static size_t cpd_index_hash(void const* key, cpd_indextype type)
+{
+    size_t h = (size_t)key >> 3;
+    h ^= h >> 16;
+    h *= 0x45d9f3b;
+    h ^= h >> 16;
+    return h + (size_t)type * 0x9e3779b9;
+}
+
+// The index is a hash table of entries, one by key and type, each entry owns the array of
+// its objects, so the objects with the same name don't cluster in the table.
+
+static size_t cpd_index_slot(cpd_index_entry const* entries, size_t size, cpd_indextype type, void const* key)
+{
+    size_t i = cpd_index_hash(key, type) & (size - 1);
+    while(entries[i].c_key && (entries[i].c_key != key || entries[i].c_type != type))
+    {
+        i = (i + 1) & (size - 1);
+    }
+    return i;
+}
+
+static char cpd_index_alloc(struct cpd_patch_index* index, size_t newsize)
+{
+    size_t i;
+    cpd_index_entry* temp = (cpd_index_entry *)cpd_calloc(newsize, sizeof(cpd_index_entry));
+    if(temp)
+    {
+        for(i = 0; i < index->c_size; ++i)
+        {
+            if(index->c_entries[i].c_key)
+            {
+                temp[cpd_index_slot(temp, newsize, index->c_entries[i].c_type, index->c_entries[i].c_key)] = index->c_entries[i];
+            }
+        }
+        cpd_free(index->c_entries);
+        index->c_entries = temp;
+        index->c_size    = newsize;
+        return 1;
+    }
+    return 0;
+}
+
+static void cpd_index_insert(struct cpd_patch_index* index, cpd_indextype type, void const* key, cpd_object* object)
+{
+    cpd_object** temp;
+    cpd_index_entry* entry;
+    if(key && key != &s_)
+    {
+        if((index->c_count + 1) * 2 > index->c_size
+           && !cpd_index_alloc(index, index->c_size ? index->c_size * 2 : 32))
+        {
+            return;
+        }
+        entry = index->c_entries + cpd_index_slot(index->c_entries, index->c_size, type, key);
+        if(entry->c_nobjects == entry->c_size)
+        {
+            temp = (cpd_object **)cpd_realloc(entry->c_objects, (entry->c_size ? entry->c_size * 2 : 1) * sizeof(cpd_object *));
+            if(!temp)
+            {
+                return;
+            }
+            entry->c_objects = temp;
+            entry->c_size    = entry->c_size ? entry->c_size * 2 : 1;
+        }
+        if(!entry->c_key)
+        {
+            entry->c_key  = key;
+            entry->c_type = type;
+            index->c_count++;
+        }
+        entry->c_objects[entry->c_nobjects++] = object;
+    }
+}
+
+static size_t cpd_index_find(struct cpd_patch_index const* index, cpd_indextype type, void const* key, cpd_object** objects, size_t size)
+{
+    size_t i;
+    cpd_index_entry const* entry;
+    if(!index->c_size)
+    {
+        return 0;
+    }
+    entry = index->c_entries + cpd_index_slot(index->c_entries, index->c_size, type, key);
+    if(objects)
+    {
+        for(i = 0; i < entry->c_nobjects && i < size; ++i)
+        {
+            objects[i] = entry->c_objects[i];
+        }
+    }
+    return entry->c_nobjects;
+}
+
+static void cpd_index_clear(struct cpd_patch_index* index)
+{
+    size_t i;
+    for(i = 0; i < index->c_size; ++i)
+    {
+        cpd_free(index->c_entries[i].c_objects);
+    }
+    cpd_free(index->c_entries);
+    index->c_entries = NULL;
+    index->c_size    = 0;
+    index->c_count   = 0;
+}
+
+static t_symbol* cpd_index_get_argument(cpd_patch const* patch, cpd_object const* object)
+{
+    t_binbuf* b = ((t_text const *)object)->te_binbuf;
+    t_atom* argv = b ? binbuf_getvec(b) : NULL;
+    if(argv && binbuf_getnatom(b) > 1)
+    {
+        if(argv[1].a_type == A_SYMBOL)
+        {
+            return argv[1].a_w.w_symbol;
+        }
+        else if(argv[1].a_type == A_DOLLSYM)
+        {
+            return canvas_realizedollar((t_canvas *)patch, argv[1].a_w.w_symbol);
+        }
+    }
+    return NULL;
+}
+
+//! @brief Indexes the objects of a patch and of its subpatches.
+//! @details The arguments of the objects are resolved in their own canvas so the $0 of
+//! the abstractions is expanded.
+static void cpd_index_glist(struct cpd_patch_index* index, t_glist const* glist)
+{
+    t_gobj* y;
+    t_symbol* name;
+    cpd_object* object;
+    for(y = glist->gl_list; y; y = y->g_next)
+    {
+        object = (cpd_object *)y;
+        name = cpd_object_get_name(object);
+        cpd_index_insert(index, CPD_INDEX_NAME, name, object);
+        if(cpd_object_is_gui(object))
+        {
+            cpd_index_insert(index, CPD_INDEX_RECEIVE, cpd_gui_get_receive_tie((cpd_gui *)object), object);
+            cpd_index_insert(index, CPD_INDEX_SEND, cpd_gui_get_send_tie((cpd_gui *)object), object);
+        }
+        else if(name == c_sym_r || name == c_sym_receive)
+        {
+            cpd_index_insert(index, CPD_INDEX_RECEIVE, cpd_index_get_argument(glist, object), object);
+        }
+        else if(name == c_sym_s || name == c_sym_send)
+        {
+            cpd_index_insert(index, CPD_INDEX_SEND, cpd_index_get_argument(glist, object), object);
+        }
+        else if(pd_class(&y->g_pd) == canvas_class)
+        {
+            cpd_index_glist(index, (t_glist *)y);
+        }
+    }
+}
+
+// ==================================================================================== //
+//                                      INTERNAL                                        //
+// ==================================================================================== //
+
+static struct cpd_patch_index** cpd_patch_index_bucket(cpd_patch const* patch)
+{
+    return c_patch_indices + (cpd_index_hash(patch, CPD_INDEX_NAME) & (CPD_PATCH_NBUCKETS - 1));
+}
+
+static struct cpd_patch_index* cpd_patch_index_get(cpd_patch const* patch)
+{
+    struct cpd_patch_index* index = *cpd_patch_index_bucket(patch);
+    while(index && index->c_patch != patch)
+    {
+        index = index->c_next;
+    }
+    return index;
+}
+
+static void cpd_patch_index_new(cpd_instance* instance, cpd_patch* patch, cpd_patch_source* source)
+{
+    struct cpd_patch_index** bucket;
+    struct cpd_patch_index* index = (struct cpd_patch_index *)cpd_malloc(sizeof(struct cpd_patch_index));
+    if(index)
+    {
+        index->c_patch    = patch;
+        index->c_entries  = NULL;
+        index->c_size     = 0;
+        index->c_count    = 0;
+        index->c_changed  = NULL;
+        index->c_changed_size  = 0;
+        index->c_changed_count = 0;
+        index->c_changed_all   = 0;
+        index->c_slots    = cpd_gui_slots_new(instance, patch, &index->c_nguis, &index->c_nslots);
+        index->c_source   = cpd_patch_source_retain(source);
+        index->c_instance = instance;
+        cpd_index_glist(index, patch);
+        cpd_mutex_lock(&c_patch_mutex);
+        bucket = cpd_patch_index_bucket(patch);
+        index->c_next = *bucket;
+        *bucket = index;
+        cpd_mutex_unlock(&c_patch_mutex);
+    }
+}
+
+static struct cpd_patch_index* cpd_patch_index_detach(cpd_patch const* patch)
+{
+    struct cpd_patch_index* index;
+    struct cpd_patch_index** bucket;
+    cpd_mutex_lock(&c_patch_mutex);
+    bucket = cpd_patch_index_bucket(patch);
+    while(*bucket && (*bucket)->c_patch != patch)
+    {
+        bucket = &((*bucket)->c_next);
+    }
+    index = *bucket;
+    if(index)
+    {
+        *bucket = index->c_next;
+    }
+    cpd_mutex_unlock(&c_patch_mutex);
+    return index;
+}
+
+//! @brief Releases the content of an index but not the index itself.
+//! @details Must be called while the instance is locked, the index can then be freed
+//! without the lock.
+static void cpd_patch_index_release(struct cpd_patch_index* index)
+{
+    if(index->c_changed)
+    {
+        cpd_gui_track_end();
+    }
+    cpd_gui_slots_free(index->c_slots, index->c_nslots);
+    cpd_patch_source_release(index->c_source);
+    cpd_index_clear(index);
+    cpd_free(index->c_changed);
+    index->c_changed        = NULL;
+    index->c_changed_size   = 0;
+    index->c_changed_count  = 0;
+    index->c_slots          = NULL;
+    index->c_nslots         = 0;
+    index->c_nguis          = 0;
+    index->c_source         = NULL;
+}
+
+static void cpd_patch_index_delete(struct cpd_patch_index* index)
+{
+    if(index)
+    {
+        cpd_patch_index_release(index);
+        cpd_free(index);
+    }
+}
+
+static size_t cpd_patch_index_find(cpd_patch const* patch, cpd_indextype type, void const* key, cpd_object** objects, size_t size)
+{
+    size_t count = 0;
+    struct cpd_patch_index* index;
+    cpd_mutex_lock(&c_patch_mutex);
+    index = cpd_patch_index_get(patch);
+    if(index)
+    {
+        count = cpd_index_find(index, type, key, objects, size);
+    }
+    cpd_mutex_unlock(&c_patch_mutex);
+    return count;
+}
+
+extern void cpd_patch_index_init()
+{
+    size_t i;
+    cpd_mutex_init(&c_patch_mutex);
+    for(i = 0; i < CPD_PATCH_NBUCKETS; ++i)
+    {
+        c_patch_indices[i] = NULL;
+    }
+    c_sym_r         = gensym("r");
+    c_sym_receive   = gensym("receive");
+    c_sym_s         = gensym("s");
+    c_sym_send      = gensym("send");
+    c_patch_files   = NULL;
+    c_patch_closing = NULL;
+    c_patch_deferred = NULL;
+}
+
+extern void cpd_patch_index_clear()
+{
+    size_t i;
+    struct cpd_patch_index* next;
+    for(i = 0; i < CPD_PATCH_NBUCKETS; ++i)
+    {
+        while(c_patch_indices[i])
+        {
+            next = c_patch_indices[i]->c_next;
+            cpd_patch_index_delete(c_patch_indices[i]);
+            c_patch_indices[i] = next;
+        }
+    }
+    while(c_patch_closing)
+    {
+        next = c_patch_closing->c_next;
+        cpd_patch_index_delete(c_patch_closing);
+        c_patch_closing = next;
+    }
+    while(c_patch_deferred)
+    {
+        next = c_patch_deferred->c_next;
+        cpd_patch_index_delete(c_patch_deferred);
+        c_patch_deferred = next;
+    }
+    while(c_patch_files)
+    {
+        cpd_patch_file* file = c_patch_files->c_next;
+        cpd_patch_source_release(c_patch_files->c_source);
+        cpd_free(c_patch_files->c_path);
+        cpd_free(c_patch_files);
+        c_patch_files = file;
+    }
+    cpd_mutex_destroy(&c_patch_mutex);
+}
+
+//! @brief Closes all the patches of an instance.
+//! @details Must be called while the instance is locked. The batches of the instance are
+//! canceled and the patches closed during the batches are freed.
+extern void cpd_patch_index_close_all(cpd_instance* instance)
+{
+    size_t i;
+    int dspstate;
+    struct cpd_patch_index* index;
+    struct cpd_patch_index* closing = NULL;
+    struct cpd_patch_index** previous = &c_patch_deferred;
+    cpd_dsp_manager_cancel_batch(instance);
+    while(*previous)
+    {
+        index = *previous;
+        if(index->c_instance == instance)
+        {
+            *previous = index->c_next;
+            index->c_next = closing;
+            closing = index;
+        }
+        else
+        {
+            previous = &index->c_next;
+        }
+    }
+    cpd_mutex_lock(&c_patch_mutex);
+    for(i = 0; i < CPD_PATCH_NBUCKETS; ++i)
+    {
+        previous = &c_patch_indices[i];
+        while(*previous)
+        {
+            index = *previous;
+            if(index->c_instance == instance)
+            {
+                *previous = index->c_next;
+                index->c_next = closing;
+                closing = index;
+            }
+            else
+            {
+                previous = &index->c_next;
+            }
+        }
+    }
+    cpd_mutex_unlock(&c_patch_mutex);
+    if(closing)
+    {
+        dspstate = canvas_suspend_dsp();
+        while(closing)
+        {
+            index = closing->c_next;
+            canvas_free(closing->c_patch);
+            cpd_patch_index_delete(closing);
+            closing = index;
+        }
+        canvas_resume_dsp(dspstate);
+    }
+}
+
+//! @brief Checks if patches closed during a batch of an instance must be freed.
+extern char cpd_patch_index_has_deferred(cpd_instance const* instance)
+{
+    struct cpd_patch_index* index;
+    for(index = c_patch_deferred; index; index = index->c_next)
+    {
+        if(index->c_instance == instance)
+        {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+//! @brief Frees the patch of a detached index.
+//! @details Must be called while the instance is locked. The patch is removed from the DSP
+//! chain, but if the patch has been closed asynchronously, its large blocks of memory are
+//! freed by cpd_memory_collect and its index is kept until the next collection.
+static void cpd_patch_index_dispose(struct cpd_patch_index* index)
+{
+    cpd_memory_defer(index->c_async);
+    canvas_free(index->c_patch);
+    cpd_memory_defer(0);
+    if(index->c_async)
+    {
+        cpd_patch_index_release(index);
+        cpd_mutex_lock(&c_patch_mutex);
+        index->c_next   = c_patch_closing;
+        c_patch_closing = index;
+        cpd_mutex_unlock(&c_patch_mutex);
+    }
+    else
+    {
+        cpd_patch_index_delete(index);
+    }
+}
+
+//! @brief Frees the patches closed during a batch of an instance.
+//! @details Must be called while the instance is locked and once the previous DSP chain
+//! has been stopped.
+extern void cpd_patch_index_free_deferred(cpd_instance* instance)
+{
+    struct cpd_patch_index* index;
+    struct cpd_patch_index** previous = &c_patch_deferred;
+    while(*previous)
+    {
+        index = *previous;
+        if(index->c_instance == instance)
+        {
+            *previous = index->c_next;
+            cpd_patch_index_dispose(index);
+        }
+        else
+        {
+            previous = &index->c_next;
+        }
+    }
+}
+
+//! @brief Closes a patch.
+//! @details Must be called while the instance is locked. During a batch, the patch is only
+//! detached and it is freed at the end of the batch, because the previous DSP chain that
+//! is still performed may use it.
+static void cpd_patch_index_close(cpd_instance* instance, cpd_patch* patch, char async)
+{
+    struct cpd_patch_index* index = cpd_patch_index_detach(patch);
+    char const batch = cpd_dsp_manager_in_batch(instance);
+    if(!index && (async || batch))
+    {
+        index = (struct cpd_patch_index *)cpd_calloc(1, sizeof(struct cpd_patch_index));
+    }
+    if(!index)
+    {
+        canvas_free(patch);
+        return;
+    }
+    index->c_patch    = patch;
+    index->c_instance = instance;
+    index->c_async    = async;
+    if(batch)
+    {
+        index->c_next     = c_patch_deferred;
+        c_patch_deferred  = index;
+    }
+    else
+    {
+        cpd_patch_index_dispose(index);
+    }
+}
+
+//! @brief Frees the indices of the patches of an instance closed asynchronously.
+//! @details The instance doesn't have to be locked.
+//! @return The number of patches.
+extern size_t cpd_patch_index_collect(cpd_instance* instance)
+{
+    size_t count = 0;
+    struct cpd_patch_index* index;
+    struct cpd_patch_index* closed = NULL;
+    struct cpd_patch_index** previous = &c_patch_closing;
+    cpd_mutex_lock(&c_patch_mutex);
+    while(*previous)
+    {
+        index = *previous;
+        if(index->c_instance == instance)
+        {
+            *previous = index->c_next;
+            index->c_next = closed;
+            closed = index;
+        }
+        else
+        {
+            previous = &index->c_next;
+        }
+    }
+    cpd_mutex_unlock(&c_patch_mutex);
+    while(closed)
+    {
+        index = closed->c_next;
+        cpd_free(closed);
+        closed = index;
+        ++count;
+    }
+    return count;
+}
+
+//! @brief Marks a gui as changed in its patch.
+//! @details The method is called by the tracked gui classes while the environment is
+//! locked. If the set is full, all the guis of the patch are considered as changed. Like
+//! the snapshots and the slots, the tracking only covers the guis of the main canvas, so
+//! the guis of the subpatches and of the abstractions are ignored.
+extern void cpd_patch_gui_changed(cpd_gui* gui)
+{
+    size_t i, mask;
+    t_canvas* canvas = gui->x_glist;
+    struct cpd_patch_index* index;
+    index = (canvas && !canvas->gl_owner) ? cpd_patch_index_get(canvas) : NULL;
+    if(index && index->c_changed && !index->c_changed_all)
+    {
+        mask = index->c_changed_size - 1;
+        i = cpd_index_hash(gui, CPD_INDEX_NAME) & mask;
+        while(index->c_changed[i] && index->c_changed[i] != gui)
+        {
+            i = (i + 1) & mask;
+        }
+        if(!index->c_changed[i])
+        {
+            if((index->c_changed_count + 1) * 2 > index->c_changed_size)
+            {
+                index->c_changed_all = 1;
+            }
+            else
+            {
+                index->c_changed[i] = gui;
+                index->c_changed_count++;
+            }
+        }
+    }
+}
+
+static void cpd_patch_changed_rehash(struct cpd_patch_index* index)
+{
+    size_t i, j, k, mask = index->c_changed_size - 1;
+    cpd_gui* gui;
+    for(i = 0; index->c_changed[i]; ++i) {}
+    for(k = 0; k < index->c_changed_size; ++k)
+    {
+        i = (i + 1) & mask;
+        if(index->c_changed[i])
+        {
+            gui = index->c_changed[i];
+            index->c_changed[i] = NULL;
+            j = cpd_index_hash(gui, CPD_INDEX_NAME) & mask;
+            while(index->c_changed[j])
+            {
+                j = (j + 1) & mask;
+            }
+            index->c_changed[j] = gui;
+        }
+    }
+}
+
+// ==================================================================================== //
+//                                      BINARY                                          //
+// ==================================================================================== //
+
+// The binary format starts with the "CPDB" tag and the version, followed by the table of
+// the symbols and the typed atoms. The symbols are stored with their terminating null
+// character, the floats as 32 bits and all the integers as unsigned 32 bits little endian.
+
+typedef enum
+{
+    CPD_BINARY_FLOAT    = 0,
+    CPD_BINARY_SYMBOL   = 1,
+    CPD_BINARY_SEMI     = 2,
+    CPD_BINARY_COMMA    = 3,
+    CPD_BINARY_DOLLAR   = 4,
+    CPD_BINARY_DOLLSYM  = 5
+} cpd_binarytype;
+
+static void cpd_binary_put(unsigned char* data, unsigned long value)
+{
+    data[0] = (unsigned char)(value & 0xff);
+    data[1] = (unsigned char)((value >> 8) & 0xff);
+    data[2] = (unsigned char)((value >> 16) & 0xff);
+    data[3] = (unsigned char)((value >> 24) & 0xff);
+}
+
+static unsigned long cpd_binary_get(unsigned char const* data)
+{
+    return (unsigned long)data[0] | ((unsigned long)data[1] << 8) |
+    ((unsigned long)data[2] << 16) | ((unsigned long)data[3] << 24);
+}
+
+//! @brief Parses the content of a binary patch.
+//! @return 0 if the content is valid, otherwise 1.
+static int cpd_binary_parse(t_binbuf* binbuf, unsigned char const* data, size_t size)
+{
+    int state = 1;
+    float f;
+    unsigned int bits;
+    unsigned long i, index, nsymbols, natoms, length;
+    size_t pos = 8;
+    t_symbol** symbols = NULL;
+    t_atom* atoms = NULL;
+    if(size < 12 || memcmp(data, "CPDB", 4) || cpd_binary_get(data + 4) != CPD_BINARY_VERSION)
+    {
+        return 1;
+    }
+    nsymbols = cpd_binary_get(data + pos);
+    pos += 4;
+    if(nsymbols > size || !(symbols = (t_symbol **)cpd_malloc((nsymbols + 1) * sizeof(t_symbol *))))
+    {
+        return 1;
+    }
+    for(i = 0; i < nsymbols; ++i)
+    {
+        if(pos + 4 > size || !(length = cpd_binary_get(data + pos)) || length > size - pos - 4 ||
+           data[pos + 4 + length - 1] != '\0')
+        {
+            goto end;
+        }
+        symbols[i] = gensym((char *)(data + pos + 4));
+        pos += 4 + length;
+    }
+    if(pos + 4 > size)
+    {
+        goto end;
+    }
+    natoms = cpd_binary_get(data + pos);
+    pos += 4;
+    if(natoms > size - pos || !(atoms = (t_atom *)cpd_malloc((natoms + 1) * sizeof(t_atom))))
+    {
+        goto end;
+    }
+    for(i = 0; i < natoms; ++i)
+    {
+        cpd_binarytype const type = (cpd_binarytype)data[pos++];
+        if(type == CPD_BINARY_SEMI)
+        {
+            SETSEMI(atoms+i);
+        }
+        else if(type == CPD_BINARY_COMMA)
+        {
+            SETCOMMA(atoms+i);
+        }
+        else
+        {
+            if(pos + 4 > size)
+            {
+                goto end;
+            }
+            index = cpd_binary_get(data + pos);
+            pos += 4;
+            if(type == CPD_BINARY_FLOAT)
+            {
+                bits = (unsigned int)index;
+                memcpy(&f, &bits, sizeof(float));
+                SETFLOAT(atoms+i, (t_float)f);
+            }
+            else if(type == CPD_BINARY_DOLLAR)
+            {
+                SETDOLLAR(atoms+i, (int)index);
+            }
+            else if(index < nsymbols && type == CPD_BINARY_SYMBOL)
+            {
+                SETSYMBOL(atoms+i, symbols[index]);
+            }
+            else if(index < nsymbols && type == CPD_BINARY_DOLLSYM)
+            {
+                SETDOLLSYM(atoms+i, symbols[index]);
+            }
+            else
+            {
+                goto end;
+            }
+        }
+    }
+    binbuf_add(binbuf, (int)natoms, atoms);
+    state = 0;
+end:
+    cpd_free(atoms);
+    cpd_free(symbols);
+    return state;
+}
+
+//! @brief Gets the index of a symbol in the table of the symbols.
+//! @details The table uses open addressing and its size must be a power of two. The new
+//! symbols are appended to the ordered symbols.
+static unsigned long cpd_binary_symbol(t_symbol** table, unsigned long* indices, size_t size, t_symbol* s,
+                                       t_symbol** ordered, unsigned long* nsymbols)
+{
+    size_t const mask = size - 1;
+    size_t i = cpd_index_hash(s, CPD_INDEX_NAME) & mask;
+    while(table[i] && table[i] != s)
+    {
+        i = (i + 1) & mask;
+    }
+    if(!table[i])
+    {
+        table[i]   = s;
+        indices[i] = *nsymbols;
+        ordered[(*nsymbols)++] = s;
+    }
+    return indices[i];
+}
+
+//! @brief Writes a binary patch.
+//! @return 0 if the file has been written, otherwise 1.
+static int cpd_binary_write(t_binbuf* binbuf, const char* path)
+{
+    int state = 1;
+    float f;
+    unsigned int bits;
+    FILE* file;
+    unsigned long i, j, value, nsymbols = 0;
+    size_t length, pos, size = 16, tsize = 16;
+    int const natoms = binbuf_getnatom(binbuf);
+    t_atom const* atoms = binbuf_getvec(binbuf);
+    t_symbol** table;
+    t_symbol** ordered;
+    unsigned long* indices;
+    unsigned char* data;
+    while(tsize < (size_t)natoms * 2)
+    {
+        tsize *= 2;
+    }
+    table   = (t_symbol **)cpd_calloc(tsize, sizeof(t_symbol *));
+    ordered = (t_symbol **)cpd_malloc(((size_t)natoms + 1) * sizeof(t_symbol *));
+    indices = (unsigned long *)cpd_malloc(tsize * sizeof(unsigned long));
+    if(!table || !ordered || !indices)
+    {
+        cpd_free(table);
+        cpd_free(ordered);
+        cpd_free(indices);
+        return 1;
+    }
+    for(i = 0; i < (unsigned long)natoms; ++i)
+    {
+        size += 5;
+        if(atoms[i].a_type == A_SYMBOL || atoms[i].a_type == A_DOLLSYM)
+        {
+            j = nsymbols;
+            cpd_binary_symbol(table, indices, tsize, atoms[i].a_w.w_symbol, ordered, &nsymbols);
+            if(j != nsymbols)
+            {
+                size += 5 + strlen(atoms[i].a_w.w_symbol->s_name);
+            }
+        }
+    }
+    data = (unsigned char *)cpd_malloc(size);
+    if(data)
+    {
+        memcpy(data, "CPDB", 4);
+        cpd_binary_put(data + 4, CPD_BINARY_VERSION);
+        cpd_binary_put(data + 8, nsymbols);
+        pos = 12;
+        for(j = 0; j < nsymbols; ++j)
+        {
+            length = strlen(ordered[j]->s_name) + 1;
+            cpd_binary_put(data + pos, (unsigned long)length);
+            memcpy(data + pos + 4, ordered[j]->s_name, length);
+            pos += 4 + length;
+        }
+        cpd_binary_put(data + pos, (unsigned long)natoms);
+        pos += 4;
+        for(i = 0; i < (unsigned long)natoms; ++i)
+        {
+            if(atoms[i].a_type == A_SEMI || atoms[i].a_type == A_COMMA)
+            {
+                data[pos++] = (unsigned char)(atoms[i].a_type == A_SEMI ? CPD_BINARY_SEMI : CPD_BINARY_COMMA);
+                continue;
+            }
+            if(atoms[i].a_type == A_FLOAT)
+            {
+                f = (float)atoms[i].a_w.w_float;
+                memcpy(&bits, &f, sizeof(float));
+                value = (unsigned long)bits;
+                data[pos] = CPD_BINARY_FLOAT;
+            }
+            else if(atoms[i].a_type == A_DOLLAR)
+            {
+                value = (unsigned long)atoms[i].a_w.w_index;
+                data[pos] = CPD_BINARY_DOLLAR;
+            }
+            else if(atoms[i].a_type == A_SYMBOL || atoms[i].a_type == A_DOLLSYM)
+            {
+                value = cpd_binary_symbol(table, indices, tsize, atoms[i].a_w.w_symbol, ordered, &nsymbols);
+                data[pos] = (unsigned char)(atoms[i].a_type == A_SYMBOL ? CPD_BINARY_SYMBOL : CPD_BINARY_DOLLSYM);
+            }
+            else
+            {
+                break;
+            }
+            cpd_binary_put(data + pos + 1, value);
+            pos += 5;
+        }
+        if(i == (unsigned long)natoms)
+        {
+            file = fopen(path, "wb");
+            if(file)
+            {
+                state = fwrite(data, 1, pos, file) != pos;
+                state = fclose(file) || state;
+            }
+        }
+        cpd_free(data);
+    }
+    cpd_free(table);
+    cpd_free(ordered);
+    cpd_free(indices);
+    return state;
+}
+
+// ==================================================================================== //
+//                                      FILES                                           //
+// ==================================================================================== //
+
+//! @brief Gets the type of a patch file.
+//! @return 1 for the binary files, 0 for the Pd files or -1 for the other files.
+static int cpd_patch_file_type(const char* name)
+{
+    size_t const size = strlen(name);
+    if(size > 4 && !strcmp(name + size - 4, ".pdb"))
+    {
+        return 1;
+    }
+    return (size > 3 && !strcmp(name + size - 3, ".pd")) ? 0 : -1;
+}
+
+//! @brief Gets the full path of a patch file.
+//! @return 0 if the path is valid, otherwise 1.
+static int cpd_patch_file_path(char* path, const char* name, const char* dir)
+{
+    size_t const dsize = strlen(dir), nsize = strlen(name);
+    if(dsize + nsize + 2 > MAXPDSTRING)
+    {
+        return 1;
+    }
+    if(dsize)
+    {
+        memcpy(path, dir, dsize);
+        path[dsize] = '/';
+        memcpy(path + dsize + 1, name, nsize + 1);
+    }
+    else
+    {
+        memcpy(path, name, nsize + 1);
+    }
+    return 0;
+}
+
+//! @brief Finds a patch file in the cache.
+//! @details Must be called while the environment is locked.
+static cpd_patch_file* cpd_patch_file_find(const char* path)
+{
+    cpd_patch_file* file;
+    for(file = c_patch_files; file; file = file->c_next)
+    {
+        if(!strcmp(file->c_path, path))
+        {
+            return file;
+        }
+    }
+    return NULL;
+}
+
+//! @brief Checks if the content of a patch file in the cache is up to date.
+static char cpd_patch_file_valid(cpd_patch_file const* file, struct stat const* st)
+{
+    return file && file->c_source && file->c_mtime == st->st_mtime && file->c_size == (size_t)st->st_size;
+}
+
+//! @brief Reads the content of a patch file.
+//! @details The method doesn't need the environment to be locked.
+static char* cpd_patch_file_read(const char* path, size_t* size)
+{
+    long length;
+    char* data = NULL;
+    FILE* file = fopen(path, "rb");
+    if(file)
+    {
+        if(!fseek(file, 0, SEEK_END) && (length = ftell(file)) >= 0 && !fseek(file, 0, SEEK_SET))
+        {
+            data = (char *)cpd_malloc((size_t)length + 1);
+            if(data && fread(data, 1, (size_t)length, file) != (size_t)length)
+            {
+                cpd_free(data);
+                data = NULL;
+            }
+            *size = (size_t)length;
+        }
+        fclose(file);
+    }
+    return data;
+}
+
+//! @brief Parses the content of a patch file and sets it in the cache.
+//! @details Must be called while the environment is locked. A new source is created
+//! because the previous one can still be used by the patches.
+static cpd_patch_source* cpd_patch_file_set(const char* path, struct stat const* st, char const* data, size_t size, char binary)
+{
+    cpd_patch_file* file = cpd_patch_file_find(path);
+    if(!file)
+    {
+        file = (cpd_patch_file *)cpd_malloc(sizeof(cpd_patch_file));
+        if(!file)
+        {
+            return NULL;
+        }
+        file->c_path = (char *)cpd_malloc(strlen(path) + 1);
+        if(!file->c_path)
+        {
+            cpd_free(file);
+            return NULL;
+        }
+        memcpy(file->c_path, path, strlen(path) + 1);
+        file->c_source = NULL;
+        file->c_next  = c_patch_files;
+        c_patch_files = file;
+    }
+    cpd_patch_source_release(file->c_source);
+    file->c_source = cpd_patch_source_new();
+    file->c_mtime = st->st_mtime;
+    file->c_size  = (size_t)st->st_size;
+    if(file->c_source)
+    {
+        if(!binary)
+        {
+            binbuf_text(file->c_source->c_binbuf, (char *)data, size);
+        }
+        else if(cpd_binary_parse(file->c_source->c_binbuf, (unsigned char const*)data, size))
+        {
+            cpd_patch_source_release(file->c_source);
+            file->c_source = NULL;
+        }
+    }
+    return file->c_source;
+}
+
+//! @brief Reads a patch file if its content isn't in the cache.
+//! @details The environment is only locked to look into the cache and to parse the
+//! content so the file is read while the other instances can perform their DSP. The loading
+//! finds the content in the cache afterward.
+static void cpd_patch_file_prefetch(const char* name, const char* dir, char binary)
+{
+    char* data;
+    size_t size;
+    struct stat st;
+    char path[MAXPDSTRING];
+    char valid;
+    if(cpd_patch_file_path(path, name, dir) || stat(path, &st))
+    {
+        return;
+    }
+    cpd_lock();
+    valid = cpd_patch_file_valid(cpd_patch_file_find(path), &st);
+    cpd_unlock();
+    if(!valid)
+    {
+        data = cpd_patch_file_read(path, &size);
+        if(data)
+        {
+            cpd_lock();
+            if(!cpd_patch_file_valid(cpd_patch_file_find(path), &st))
+            {
+                cpd_patch_file_set(path, &st, data, size, binary);
+            }
+            cpd_unlock();
+            cpd_free(data);
+        }
+    }
+}
+
+//! @brief Gets the parsed content of a patch file.
+//! @details Must be called while the environment is locked. The content is read and parsed
+//! only if the file isn't in the cache or if its modification time or its size changed
+//! since the last reading.
+static cpd_patch_source* cpd_patch_file_get(t_symbol* name, t_symbol* dir, char binary)
+{
+    char* data;
+    size_t size;
+    struct stat st;
+    cpd_patch_file* file;
+    cpd_patch_source* source = NULL;
+    char path[MAXPDSTRING];
+    if(cpd_patch_file_path(path, name->s_name, dir->s_name) || stat(path, &st))
+    {
+        return NULL;
+    }
+    file = cpd_patch_file_find(path);
+    if(cpd_patch_file_valid(file, &st))
+    {
+        return file->c_source;
+    }
+    data = cpd_patch_file_read(path, &size);
+    if(data)
+    {
+        source = cpd_patch_file_set(path, &st, data, size, binary);
+        cpd_free(data);
+    }
+    return source;
+}
+
+//! @brief Evaluates the content of a patch file.
+//! @details This is the same as glob_evalfile but the binbuf is not read from the file.
+static t_canvas* cpd_patch_evaluate(t_binbuf* binbuf, t_symbol* name, t_symbol* dir)
+{
+    t_pd* x = NULL;
+    t_symbol* s_A = gensym("#A");
+    int const dspstate = canvas_suspend_dsp();
+    t_pd* const boundx = s__X.s_thing;
+    t_pd* const bounda = s_A->s_thing;
+    t_pd* const boundn = s__N.s_thing;
+    s__X.s_thing = NULL;
+    s_A->s_thing = NULL;
+    s__N.s_thing = &pd_canvasmaker;
+    glob_setfilename(NULL, name, dir);
+    binbuf_eval(binbuf, NULL, 0, NULL);
+    glob_setfilename(NULL, &s_, &s_);
+    s_A->s_thing = bounda;
+    s__N.s_thing = boundn;
+    while((x != s__X.s_thing) && s__X.s_thing)
+    {
+        x = s__X.s_thing;
+        vmess(x, gensym("pop"), "i", 1);
+    }
+    pd_doloadbang();
+    canvas_resume_dsp(dspstate);
+    s__X.s_thing = boundx;
+    return (t_canvas *)x;
+}
+
+//! @brief Loads a patch file.
+//! @details Only the Pd files and the binary files are cached, the Max files still need to
+//! be imported.
+static t_canvas* cpd_patch_evalfile(const char* name, const char* dir, cpd_patch_source** source)
+{
+    int const type = cpd_patch_file_type(name);
+    t_symbol* const sname = gensym(name);
+    t_symbol* const sdir  = gensym(dir);
+    if(type >= 0)
+    {
+        *source = cpd_patch_file_get(sname, sdir, (char)type);
+        return *source ? cpd_patch_evaluate((*source)->c_binbuf, sname, sdir) : NULL;
+    }
+    *source = NULL;
+    return (t_canvas *)glob_evalfile(NULL, sname, sdir);
+}
+
+// ==================================================================================== //
+//                                      INTERFACE                                       //
+// ==================================================================================== //
 
 cpd_patch* cpd_instance_patch_load(cpd_instance* instance, const char* name, const char* path)
 {
     int i;
-    char* rpath;
+    char known;
+    char* rpath = NULL;
+    const char* cpath;
     t_canvas* cnv = NULL;
+    cpd_patch_source* source = NULL;
+    char dir[MAXPDSTRING];
+    int const type = name ? cpd_patch_file_type(name) : -1;
+    // The file is read before locking the instance, so the instances can perform their DSP
+    // during the I/O. Only the parsing and the creation of the objects remain locked.
+    if(type >= 0 && path)
+    {
+        cpd_patch_file_prefetch(name, path, (char)type);
+    }
+    else if(type >= 0)
+    {
+        cpd_lock();
+        cpd_searchpath_find(name, &cpath);
+        dir[0] = '\0';
+        if(cpath && strlen(cpath) < MAXPDSTRING)
+        {
+            memcpy(dir, cpath, strlen(cpath) + 1);
+        }
+        cpd_unlock();
+        if(dir[0])
+        {
+            cpd_patch_file_prefetch(name, dir, (char)type);
+        }
+    }
     cpd_instance_lock(instance);
     if(name && path)
     {
-        cnv = (t_canvas *)glob_evalfile(NULL, gensym(name), gensym(path));
-        if(cnv)
+        cnv = cpd_patch_evalfile(name, path, &source);
+    }
+    else if(name)
+    {
+        // The cache of the search path avoids to probe all the directories, the probing is
+        // only used if the file has been added or removed since the creation of the cache
+        // and its result is cached, so a missing file is only probed once.
+        known = cpd_searchpath_find(name, &cpath);
+        if(cpath)
+        {
+            cnv = cpd_patch_evalfile(name, cpath, &source);
+        }
+        if(!cnv && (!known || cpath))
         {
-            cpd_instance_unlock(instance);
-            return cnv;
+            i = 0;
+            while(!cnv && (rpath = namelist_get(sys_searchpath, i)) != NULL)
+            {
+                if(rpath != cpath)
+                {
+                    cnv = cpd_patch_evalfile(name, rpath, &source);
+                }
+                i++;
+            }
+            cpd_searchpath_set(name, cnv ? rpath : NULL);
         }
     }
-    else if(name)
+    if(cnv)
+    {
+        cpd_patch_index_new(instance, cnv, source);
+    }
+    cpd_instance_unlock(instance);
+    return cnv;
+}
+
+cpd_patch* cpd_instance_patch_load_from_memory(cpd_instance* instance, const char* name, const char* path, const char* text, size_t size)
+{
+    cpd_patch_source* source;
+    t_canvas* cnv = NULL;
+    if(name && text)
     {
-        
-        i = 0;
-        while((rpath = namelist_get(sys_searchpath, i)) != NULL)
+        // The parsing creates symbols, so it must be done while the environment is locked.
+        cpd_instance_lock(instance);
+        source = cpd_patch_source_new();
+        if(source)
         {
-            cnv = (t_canvas *)glob_evalfile(NULL, gensym(name), gensym(rpath));
+            binbuf_text(source->c_binbuf, (char *)text, size);
+            cnv = cpd_patch_evaluate(source->c_binbuf, gensym(name), gensym(path ? path : ""));
             if(cnv)
             {
-                cpd_instance_unlock(instance);
-                return cnv;
+                cpd_patch_index_new(instance, cnv, source);
             }
-            i++;
+            cpd_patch_source_release(source);
+        }
+        cpd_instance_unlock(instance);
+    }
+    return cnv;
+}
+
+cpd_patch* cpd_instance_patch_clone(cpd_instance* instance, cpd_patch const* patch)
+{
+    t_canvas* cnv = NULL;
+    struct cpd_patch_index* index;
+    cpd_instance_lock(instance);
+    index = cpd_patch_index_get(patch);
+    if(index && index->c_source)
+    {
+        cnv = cpd_patch_evaluate(index->c_source->c_binbuf, patch->gl_name, canvas_getdir((t_glist *)patch));
+        if(cnv)
+        {
+            cpd_patch_index_new(instance, cnv, index->c_source);
         }
     }
     cpd_instance_unlock(instance);
-    return NULL;
+    return cnv;
+}
+
+void cpd_instance_patch_close_async(cpd_instance* instance, cpd_patch* patch)
+{
+    cpd_instance_lock(instance);
+    cpd_patch_index_close(instance, patch, 1);
+    cpd_instance_unlock(instance);
+}
+
+size_t cpd_instance_patch_collect(cpd_instance* instance)
+{
+    size_t const count = cpd_patch_index_collect(instance);
+    cpd_memory_collect();
+    return count;
+}
+
+char cpd_patch_compile(const char* name, const char* path, const char* output)
+{
+    cpd_patch_source* source;
+    int const type = name ? cpd_patch_file_type(name) : -1;
+    char state = 0;
+    if(type >= 0 && output)
+    {
+        cpd_lock();
+        source = cpd_patch_file_get(gensym(name), gensym(path ? path : ""), (char)type);
+        if(source)
+        {
+            state = !cpd_binary_write(source->c_binbuf, output);
+        }
+        cpd_unlock();
+    }
+    return state;
 }
 
 void cpd_instance_patch_close(cpd_instance* instance, cpd_patch* patch)
 {
     cpd_instance_lock(instance);
-    canvas_free(patch);
+    cpd_patch_index_close(instance, patch, 0);
+    cpd_instance_unlock(instance);
+}
+
+void cpd_instance_patch_reindex(cpd_instance* instance, cpd_patch* patch)
+{
+    cpd_index_entry* entries;
+    size_t size, count;
+    struct cpd_patch_index* index;
+    struct cpd_patch_index temp;
+    temp.c_entries  = NULL;
+    temp.c_size     = 0;
+    temp.c_count    = 0;
+    cpd_instance_lock(instance);
+    cpd_index_glist(&temp, patch);
+    cpd_mutex_lock(&c_patch_mutex);
+    index = cpd_patch_index_get(patch);
+    if(index)
+    {
+        entries = index->c_entries;
+        size    = index->c_size;
+        count   = index->c_count;
+        index->c_entries = temp.c_entries;
+        index->c_size    = temp.c_size;
+        index->c_count   = temp.c_count;
+        temp.c_entries   = entries;
+        temp.c_size      = size;
+        temp.c_count     = count;
+    }
+    cpd_mutex_unlock(&c_patch_mutex);
+    cpd_index_clear(&temp);
     cpd_instance_unlock(instance);
 }
 
@@ -108,15 +1441,188 @@ cpd_object* cpd_patch_get_next_object(cpd_patch const* patch, cpd_object const*
     return (cpd_object *)((t_gobj *)previous)->g_next;
 }
 
+size_t cpd_patch_get_all_bounds(cpd_patch const* patch, cpd_bounds* bounds, size_t size)
+{
+    size_t count = 0;
+    cpd_object* object;
+    for(object = cpd_patch_get_first_object(patch); object; object = cpd_patch_get_next_object(patch, object))
+    {
+        if(bounds && count < size)
+        {
+            bounds[count].object = object;
+            cpd_object_get_bounds(object, patch, &bounds[count].x, &bounds[count].y, &bounds[count].width, &bounds[count].height);
+        }
+        ++count;
+    }
+    return count;
+}
 
+size_t cpd_patch_get_objects_by_name(cpd_patch const* patch, cpd_symbol const* name, cpd_object** objects, size_t size)
+{
+    return cpd_patch_index_find(patch, CPD_INDEX_NAME, name, objects, size);
+}
 
+size_t cpd_patch_get_objects_by_receive_tie(cpd_patch const* patch, cpd_tie const* tie, cpd_object** objects, size_t size)
+{
+    return cpd_patch_index_find(patch, CPD_INDEX_RECEIVE, tie, objects, size);
+}
 
+size_t cpd_patch_get_objects_by_send_tie(cpd_patch const* patch, cpd_tie const* tie, cpd_object** objects, size_t size)
+{
+    return cpd_patch_index_find(patch, CPD_INDEX_SEND, tie, objects, size);
+}
 
+size_t cpd_patch_get_number_of_guis(cpd_patch const* patch)
+{
+    size_t count = 0;
+    struct cpd_patch_index* index;
+    cpd_mutex_lock(&c_patch_mutex);
+    index = cpd_patch_index_get(patch);
+    if(index)
+    {
+        count = index->c_nguis;
+    }
+    cpd_mutex_unlock(&c_patch_mutex);
+    return count;
+}
 
+char cpd_patch_track_guis(cpd_patch* patch, char state)
+{
+    size_t size = 16;
+    cpd_gui** changed = NULL;
+    struct cpd_patch_index* index;
+    char const locked = cpd_is_locked();
+    if(!locked)
+    {
+        cpd_lock();
+    }
+    index = cpd_patch_index_get(patch);
+    if(index)
+    {
+        if(state)
+        {
+            while(size < index->c_nguis * 2)
+            {
+                size *= 2;
+            }
+            changed = (cpd_gui **)cpd_calloc(size, sizeof(cpd_gui *));
+            if(!changed)
+            {
+                if(!locked)
+                {
+                    cpd_unlock();
+                }
+                return 0;
+            }
+            if(!index->c_changed)
+            {
+                cpd_gui_track_begin(patch);
+            }
+        }
+        else if(index->c_changed)
+        {
+            cpd_gui_track_end();
+        }
+        cpd_free(index->c_changed);
+        index->c_changed          = changed;
+        index->c_changed_size     = changed ? size : 0;
+        index->c_changed_count    = 0;
+        index->c_changed_all      = 0;
+    }
+    if(!locked)
+    {
+        cpd_unlock();
+    }
+    return index ? 1 : 0;
+}
 
+size_t cpd_patch_collect_changed_guis(cpd_patch const* patch, cpd_gui** guis, size_t size)
+{
+    size_t i, count = 0;
+    cpd_object* object;
+    struct cpd_patch_index* index;
+    char const locked = cpd_is_locked();
+    if(!locked)
+    {
+        cpd_lock();
+    }
+    index = cpd_patch_index_get(patch);
+    if(index && index->c_changed)
+    {
+        if(index->c_changed_all)
+        {
+            for(object = cpd_patch_get_first_object(patch); object; object = cpd_patch_get_next_object(patch, object))
+            {
+                if(cpd_object_is_gui(object))
+                {
+                    if(guis && count < size)
+                    {
+                        guis[count] = (cpd_gui *)object;
+                    }
+                    ++count;
+                }
+            }
+            if(guis && count <= size)
+            {
+                memset(index->c_changed, 0, index->c_changed_size * sizeof(cpd_gui *));
+                index->c_changed_count = 0;
+                index->c_changed_all   = 0;
+            }
+        }
+        else
+        {
+            count = index->c_changed_count;
+            if(guis && size)
+            {
+                for(i = 0; i < index->c_changed_size && index->c_changed_count && count - index->c_changed_count < size; ++i)
+                {
+                    if(index->c_changed[i])
+                    {
+                        guis[count - index->c_changed_count] = index->c_changed[i];
+                        index->c_changed[i] = NULL;
+                        index->c_changed_count--;
+                    }
+                }
+                if(index->c_changed_count)
+                {
+                    cpd_patch_changed_rehash(index);
+                }
+            }
+        }
+    }
+    if(!locked)
+    {
+        cpd_unlock();
+    }
+    return count;
+}
 
+cpd_gui_slot* cpd_gui_get_slot(cpd_gui const* gui)
+{
+    t_canvas* canvas = gui->x_glist;
+    struct cpd_patch_index* index;
+    struct cpd_gui_slot* slot = NULL;
+    while(canvas && canvas->gl_owner)
+    {
+        canvas = canvas->gl_owner;
+    }
+    cpd_mutex_lock(&c_patch_mutex);
+    index = canvas ? cpd_patch_index_get(canvas) : NULL;
+    if(index)
+    {
+        slot = cpd_gui_slots_find(index->c_slots, index->c_nslots, gui);
+    }
+    cpd_mutex_unlock(&c_patch_mutex);
+    return slot;
+}
 
-
-
-
-
+char cpd_gui_set_value(cpd_gui* gui, float value)
+{
+    cpd_gui_slot* slot = cpd_gui_get_slot(gui);
+    if(slot)
+    {
+        cpd_gui_slot_set_value(slot, value);
+        return 1;
+    }
+    return 0;
+}
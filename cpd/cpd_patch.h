@@ -20,6 +20,17 @@
 //! @addtogroup patch
 //! @{
 
+//! @brief The bounds of an object within a patch.
+//! @see cpd_patch_get_all_bounds
+typedef struct cpd_bounds
+{
+    cpd_object* object; //!< @brief The object.
+    int         x;      //!< @brief The x position of the object.
+    int         y;      //!< @brief The y position of the object.
+    int         width;  //!< @brief The width of the object.
+    int         height; //!< @brief The height of the object.
+}cpd_bounds;
+
 //! @brief Loads a new patch.
 //! @param instance The instance.
 //! @param name The name of the patch.
@@ -27,11 +38,69 @@
 //! @return The pointer to the patch or NULL if the patch has not been allocated.
 CPD_EXTERN cpd_patch* cpd_instance_patch_load(cpd_instance* instance, const char* name, const char* path);
 
+//! @brief Loads a new patch from a text in memory.
+//! @details The text is parsed like the content of a patch file and no file is read.
+//! The path is only used as the directory of the patch to find the abstractions.
+//! @param instance The instance.
+//! @param name The name of the patch.
+//! @param path The virtual directory of the patch or NULL.
+//! @param text The content of the patch.
+//! @param size The size of the content.
+//! @return The pointer to the patch or NULL if the patch has not been allocated.
+CPD_EXTERN cpd_patch* cpd_instance_patch_load_from_memory(cpd_instance* instance, const char* name, const char* path, const char* text, size_t size);
+
+//! @brief Closes a patch and frees its memory later.
+//! @details The patch is removed from the DSP chain and unbound from its receivers
+//! immediately, but its large blocks of memory, like the arrays and the delay lines, are
+//! only freed by cpd_instance_patch_collect or cpd_memory_collect, so the instance is only
+//! locked for a short time. During a batch, the patch is removed at the end of the batch.
+//! @param instance The instance.
+//! @param patch The patch.
+//! @see cpd_instance_patch_collect
+CPD_EXTERN void cpd_instance_patch_close_async(cpd_instance* instance, cpd_patch* patch);
+
+//! @brief Frees the memory of the patches closed with cpd_instance_patch_close_async.
+//! @details The instance isn't locked and the DSP chain isn't sorted, the method frees the
+//! memory released by all the asynchronous closings and should be called from a thread
+//! that isn't time critical.
+//! @param instance The instance.
+//! @return The number of patches of the instance closed since the last collection.
+CPD_EXTERN size_t cpd_instance_patch_collect(cpd_instance* instance);
+
+//! @brief Clones a patch.
+//! @details The new patch is created from the content that has been used to load the
+//! patch, the changes made since the loading are ignored. The patch can be cloned in
+//! another instance and the new patch gets its own dollar zero.
+//! @param instance The instance of the new patch.
+//! @param patch The patch to clone.
+//! @return The pointer to the new patch or NULL if the patch can't be cloned.
+CPD_EXTERN cpd_patch* cpd_instance_patch_clone(cpd_instance* instance, cpd_patch const* patch);
+
+//! @brief Converts a patch file to the binary format.
+//! @details The binary files use the extension ".pdb" and are loaded without parsing the
+//! text with cpd_instance_patch_load.
+//! @param name The name of the patch.
+//! @param path The path of the patch.
+//! @param output The path of the binary file.
+//! @return 1 if the binary file has been written, otherwise 0.
+CPD_EXTERN char cpd_patch_compile(const char* name, const char* path, const char* output);
+
 //! @brief Closes a patch.
+//! @details During a batch, the patch is still performed until the end of the batch.
 //! @param instance The instance.
 //! @param patch The patch.
+//! @see cpd_instance_begin_batch
 CPD_EXTERN void cpd_instance_patch_close(cpd_instance* instance, cpd_patch* patch);
 
+//! @brief Rebuilds the index of a patch.
+//! @details The index is built at the loading and isn't updated by the edits of the patch,
+//! the method must be called after the objects of a patch have been created, deleted or
+//! retied by dynamic patching. The slots of the guis aren't rebuilt, the values of the
+//! guis created afterward can't be set.
+//! @param instance The instance.
+//! @param patch The patch.
+CPD_EXTERN void cpd_instance_patch_reindex(cpd_instance* instance, cpd_patch* patch);
+
 //! @brief Gets the name of a patch.
 //! @param patch The patch.
 //! @return The name of the patch.
@@ -78,6 +147,54 @@ CPD_EXTERN cpd_object* cpd_patch_get_first_object(cpd_patch const* patch);
 //! @return The pointer to the next object of the patch if there is one, otherwise NULL.
 CPD_EXTERN cpd_object* cpd_patch_get_next_object(cpd_patch const* patch, cpd_object const* previous);
 
+//! @brief Gets the bounds of all the objects of a patch.
+//! @details The objects are retrieved in one walk, in the same order as with
+//! cpd_patch_get_first_object and cpd_patch_get_next_object. If the array is too small,
+//! only the bounds of the first objects are retrieved. You can pass a NULL array to only
+//! count the objects.
+//! @param patch The patch.
+//! @param bounds The array of bounds to fill or NULL.
+//! @param size The size of the array.
+//! @return The number of objects of the patch.
+CPD_EXTERN size_t cpd_patch_get_all_bounds(cpd_patch const* patch, cpd_bounds* bounds, size_t size);
+
+//! @brief Gets the objects of a patch with a specific name.
+//! @details The patch owns an index built at the loading that also contains the objects
+//! of its subpatches and abstractions, so the cost of the method doesn't depend on the
+//! number of objects in the patch. The index reflects the patch as it has been loaded or
+//! reindexed, it becomes stale if objects are created, deleted or retied afterward by
+//! dynamic patching, until cpd_instance_patch_reindex is called. If the array
+//! is too small, only the first objects are retrieved. You can pass a NULL array to only
+//! count the objects.
+//! @param patch The patch.
+//! @param name The name of the objects.
+//! @param objects The array of objects to fill or NULL.
+//! @param size The size of the array.
+//! @return The number of objects with the name.
+CPD_EXTERN size_t cpd_patch_get_objects_by_name(cpd_patch const* patch, cpd_symbol const* name, cpd_object** objects, size_t size);
+
+//! @brief Gets the objects of a patch bound to a receive tie.
+//! @details The method retrieves the guis and the receive objects using the index of the
+//! patch. If the array is too small, only the first objects are retrieved. You can pass a
+//! NULL array to only count the objects.
+//! @param patch The patch.
+//! @param tie The receive tie.
+//! @param objects The array of objects to fill or NULL.
+//! @param size The size of the array.
+//! @return The number of objects bound to the tie.
+CPD_EXTERN size_t cpd_patch_get_objects_by_receive_tie(cpd_patch const* patch, cpd_tie const* tie, cpd_object** objects, size_t size);
+
+//! @brief Gets the objects of a patch that send to a tie.
+//! @details The method retrieves the guis and the send objects using the index of the
+//! patch. If the array is too small, only the first objects are retrieved. You can pass a
+//! NULL array to only count the objects.
+//! @param patch The patch.
+//! @param tie The send tie.
+//! @param objects The array of objects to fill or NULL.
+//! @param size The size of the array.
+//! @return The number of objects that send to the tie.
+CPD_EXTERN size_t cpd_patch_get_objects_by_send_tie(cpd_patch const* patch, cpd_tie const* tie, cpd_object** objects, size_t size);
+
 //! @}
 
 
@@ -10,36 +10,196 @@
 
 
 #include "cpd_post.h"
+#include "cpd_atomic.h"
 #include "../pd/src/m_pd.h"
 #include "../pd/src/s_stuff.h"
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <stdio.h>
 
 extern cpd_instance* c_current_instance;
 
 struct cpd_post_manager
 {
+    cpd_instance*   c_instance;
     cpd_hook_post   c_hook;
+    int             c_level;
+    char            c_collapse;
+    int             c_last_level;
+    size_t          c_last_size;
+    size_t          c_repeat;
+    size_t          c_budget;
+    size_t          c_count;
+    size_t          c_dropped;
+    double          c_window;
+    char            c_performing;
+    cpd_atomic_int  c_collapse_request;
+    cpd_atomic_int  c_budget_request;
+    char            c_last[MAXPDSTRING];
 };
 
+// The settings can be changed from the hooks while the instance is locked, so they are
+// requested without the lock, stored plus one in atomic integers (0 means no request),
+// and applied by the instance the next time it posts or performs.
+
 
 // ==================================================================================== //
 //                                      INTERNAL                                        //
 // ==================================================================================== //
 
-extern void cpd_post_manager_init(cpd_instance* instance)
+extern size_t cpd_post_manager_size()
 {
-    instance->c_post = (struct cpd_post_manager *)malloc(sizeof(struct cpd_post_manager));
+    return sizeof(struct cpd_post_manager);
+}
+
+extern void cpd_post_manager_init(cpd_instance* instance, void* memory)
+{
+    instance->c_post = (struct cpd_post_manager *)memory;
     if(instance->c_post)
     {
-        instance->c_post->c_hook = NULL;
+        instance->c_post->c_instance    = instance;
+        instance->c_post->c_hook        = NULL;
+        instance->c_post->c_level       = cpd_post_log;
+        instance->c_post->c_collapse    = 0;
+        instance->c_post->c_last_level  = 0;
+        instance->c_post->c_last_size   = 0;
+        instance->c_post->c_repeat      = 0;
+        instance->c_post->c_budget      = 0;
+        instance->c_post->c_count       = 0;
+        instance->c_post->c_dropped     = 0;
+        instance->c_post->c_window      = 0.;
+        instance->c_post->c_performing  = 0;
+        instance->c_post->c_last[0]     = '\0';
+        cpd_atomic_int_store(&instance->c_post->c_collapse_request, 0);
+        cpd_atomic_int_store(&instance->c_post->c_budget_request, 0);
     }
 }
 
+//! @brief Resets the hook, the settings and the posts of an instance.
+//! @details The repeated post that is waiting and the count of the dropped posts are
+//! discarded without calling the hook.
+extern void cpd_post_manager_reset(cpd_instance* instance)
+{
+    cpd_post_manager_init(instance, instance->c_post);
+}
+
 extern void cpd_post_manager_clear(cpd_instance* instance)
 {
-    free(instance->c_post);
+    instance->c_post = NULL;
+}
+
+//! @brief Gets the verbosity of Pure Data that matches the level of an instance.
+//! @details The verbose posts of Pure Data are only formatted if their level is lower or
+//! equal to the verbosity, so the verbosity is set each time the instance is locked.
+extern int cpd_post_manager_get_verbosity(struct cpd_post_manager const* manager)
+{
+    return (manager && manager->c_level < cpd_post_log) ? manager->c_level : 4;
+}
+
+static char cpd_post_manager_accept(struct cpd_post_manager const* manager, int level)
+{
+    return manager && manager->c_hook && (manager->c_level >= cpd_post_log || level <= manager->c_level);
+}
+
+static void cpd_post_manager_emit(struct cpd_post_manager* manager, int level, const char* text, size_t repeat)
+{
+    if(manager->c_budget && manager->c_performing)
+    {
+        if(manager->c_count >= manager->c_budget)
+        {
+            manager->c_dropped += repeat ? repeat : 1;
+            return;
+        }
+        manager->c_count++;
+    }
+    manager->c_hook(manager->c_instance, (cpd_post){(cpd_postlevel)level, text, repeat});
+}
+
+static void cpd_post_manager_flush(struct cpd_post_manager* manager)
+{
+    if(manager->c_repeat)
+    {
+        cpd_post_manager_emit(manager, manager->c_last_level, manager->c_last, manager->c_repeat);
+        manager->c_repeat = 0;
+    }
+}
+
+//! @brief Applies the settings requested since the last call.
+//! @details The method is called while the instance is locked.
+static void cpd_post_manager_update(struct cpd_post_manager* manager)
+{
+    long const collapse = cpd_atomic_int_exchange(&manager->c_collapse_request, 0);
+    long const budget   = cpd_atomic_int_exchange(&manager->c_budget_request, 0);
+    if(collapse)
+    {
+        if(collapse == 1 && manager->c_hook)
+        {
+            cpd_post_manager_flush(manager);
+        }
+        manager->c_collapse    = (char)(collapse - 1);
+        manager->c_last_size   = 0;
+        manager->c_repeat      = 0;
+        manager->c_window      = clock_getlogicaltime();
+    }
+    if(budget)
+    {
+        manager->c_budget  = (size_t)(budget - 1);
+        manager->c_count   = 0;
+        manager->c_dropped = 0;
+        manager->c_window  = clock_getlogicaltime();
+    }
+}
+
+//! @brief Flushes the repeated posts and resets the budget of posts every second.
+//! @details The method is called while the instance is locked, at the beginning of the
+//! perform with the state 1 and at the end with the state 0. The budget only applies to
+//! the posts made during the perform, the period uses the logical time of Pure Data.
+extern void cpd_post_manager_perform(struct cpd_post_manager* manager, char state)
+{
+    char temp[64];
+    size_t dropped;
+    cpd_post_manager_update(manager);
+    manager->c_performing = state;
+    if(state)
+    {
+        return;
+    }
+    if((manager->c_collapse || manager->c_budget) && clock_gettimesince(manager->c_window) >= 1000.)
+    {
+        manager->c_window   = clock_getlogicaltime();
+        manager->c_count    = 0;
+        if(manager->c_hook)
+        {
+            cpd_post_manager_flush(manager);
+        }
+        dropped = manager->c_dropped;
+        manager->c_dropped  = 0;
+        if(dropped && manager->c_hook)
+        {
+            sprintf(temp, "%lu posts dropped", (unsigned long)dropped);
+            cpd_post_manager_emit(manager, cpd_post_error, temp, 0);
+        }
+    }
+}
+
+static void cpd_post_manager_post(struct cpd_post_manager* manager, int level, const char* text, size_t size)
+{
+    cpd_post_manager_update(manager);
+    if(manager->c_collapse)
+    {
+        if(manager->c_last_size == size && manager->c_last_level == level && !memcmp(manager->c_last, text, size))
+        {
+            manager->c_repeat++;
+            return;
+        }
+        cpd_post_manager_flush(manager);
+        memcpy(manager->c_last, text, size);
+        manager->c_last[size]   = '\0';
+        manager->c_last_size    = size;
+        manager->c_last_level   = level;
+    }
+    cpd_post_manager_emit(manager, level, text, 0);
 }
 
 
@@ -52,9 +212,30 @@ void cpd_instance_post_sethook(cpd_instance* instance, cpd_hook_post posthook)
     instance->c_post->c_hook = posthook;
 }
 
+void cpd_instance_post_setlevel(cpd_instance* instance, cpd_postlevel level)
+{
+    instance->c_post->c_level = (int)level;
+}
+
+cpd_postlevel cpd_instance_post_getlevel(cpd_instance const* instance)
+{
+    return (cpd_postlevel)instance->c_post->c_level;
+}
+
+void cpd_instance_post_setcollapse(cpd_instance* instance, char state)
+{
+    cpd_atomic_int_store(&instance->c_post->c_collapse_request, state ? 2 : 1);
+}
+
+void cpd_instance_post_setbudget(cpd_instance* instance, size_t nposts)
+{
+    long const max = 0x7ffffffe;
+    cpd_atomic_int_store(&instance->c_post->c_budget_request, (nposts < (size_t)max ? (long)nposts : max) + 1);
+}
+
 void cpd_instance_post_send(cpd_instance* instance, cpd_post post)
 {
-    if(instance->c_post && instance->c_post->c_hook)
+    if(cpd_post_manager_accept(instance->c_post, (int)post.level))
     {
         instance->c_post->c_hook(instance, post);
     }
@@ -73,7 +254,7 @@ extern void cpd_print(const char* s)
 #ifdef DEBUG
     printf("%s", s);
 #endif
-    if(!instance)
+    if(!instance || !instance->c_post || !instance->c_post->c_hook)
     {
         return;
     }
@@ -87,6 +268,10 @@ extern void cpd_print(const char* s)
         level = atoi(s+8);
         s+=12;
     }
+    if(!cpd_post_manager_accept(instance->c_post, level))
+    {
+        return;
+    }
     len = strlen(s);
     while(len && (s[len-1] == '\0' || s[len-1] == '\n'))
     {
@@ -94,12 +279,10 @@ extern void cpd_print(const char* s)
     }
     if(len)
     {
-        memset(temp, '\0', MAXPDSTRING);
-        strncpy(temp, s, len);
-        if(instance->c_post && instance->c_post->c_hook)
-        {
-            instance->c_post->c_hook(instance, (cpd_post){(cpd_postlevel)level, temp});
-        }
+        len = (len < MAXPDSTRING) ? len : MAXPDSTRING - 1;
+        memcpy(temp, s, len);
+        temp[len] = '\0';
+        cpd_post_manager_post(instance->c_post, level, temp, len);
     }
     
 }
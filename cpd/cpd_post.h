@@ -32,8 +32,9 @@ typedef enum cpd_postlevel
 //! @details  The post is a simple structure that defines
 typedef struct cpd_post
 {
-    cpd_postlevel level;
-    const char*   text;
+    cpd_postlevel level;    //!< @brief The level of the post.
+    const char*   text;     //!< @brief The text of the post.
+    size_t        repeat;   //!< @brief The number of repetitions of the previous post.
 }cpd_post;
 
 //! @brief The post function prototype.
@@ -46,6 +47,40 @@ typedef void (*cpd_hook_post)(cpd_instance* instance, cpd_post);
 //! @param posthook The post function.
 CPD_EXTERN void cpd_instance_post_sethook(cpd_instance* instance, cpd_hook_post posthook);
 
+//! @brief Sets the level of the posts of an instance.
+//! @details The posts that are less important than the level are discarded. The verbose
+//! posts of Pure Data are discarded before their formatting and the other posts before
+//! they are copied. The default level is cpd_post_log, that keeps all the posts.
+//! @param instance The instance.
+//! @param level The least important level of the posts.
+CPD_EXTERN void cpd_instance_post_setlevel(cpd_instance* instance, cpd_postlevel level);
+
+//! @brief Gets the level of the posts of an instance.
+//! @param instance The instance.
+//! @return The least important level of the posts.
+CPD_EXTERN cpd_postlevel cpd_instance_post_getlevel(cpd_instance const* instance);
+
+//! @brief Enables or disables the collapsing of the repeated posts of an instance.
+//! @details When the collapsing is enabled, the first post of a sequence of identical
+//! posts of Pure Data is sent and the following ones are counted. The count is sent with
+//! the text of the post and a repeat value when another post arrives or every second of
+//! the logical time. The collapsing is disabled by default. The method doesn't lock the
+//! instance, so it can be called from a hook, the state is applied the next time the
+//! instance posts or performs.
+//! @param instance The instance.
+//! @param state 1 to enable the collapsing, 0 to disable it.
+CPD_EXTERN void cpd_instance_post_setcollapse(cpd_instance* instance, char state);
+
+//! @brief Sets the maximum number of posts of Pure Data sent per second by an instance.
+//! @details The budget only applies to the posts made while the instance performs, the
+//! extra posts are dropped and an error post gives the number of dropped posts every
+//! second of the logical time. The default budget is 0, that means no limit. The method
+//! doesn't lock the instance, so it can be called from a hook, the budget is applied the
+//! next time the instance posts or performs.
+//! @param instance The instance.
+//! @param nposts The maximum number of posts per second or 0.
+CPD_EXTERN void cpd_instance_post_setbudget(cpd_instance* instance, size_t nposts);
+
 //! @brief Sends a normal post to the current instance.
 //! @param instance The instance.
 //! @param post     The post message.
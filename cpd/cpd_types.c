@@ -13,6 +13,11 @@
 #include "../pd/src/m_pd.h"
 #include <stdlib.h>
 
+extern void* cpd_malloc(size_t size);
+extern void* cpd_calloc(size_t count, size_t size);
+extern void* cpd_realloc(void* ptr, size_t size);
+extern void cpd_free(void* ptr);
+
 
 cpd_tie* cpd_tie_create(const char* name)
 {
@@ -49,7 +54,7 @@ void cpd_list_init(cpd_list *list, size_t size)
 {
     if(size)
     {
-        list->vector = (void *)malloc(size * sizeof(t_atom));
+        list->vector = (void *)cpd_malloc(size * sizeof(t_atom));
         if(list->vector)
         {
             list->size = size;
@@ -70,7 +75,7 @@ void cpd_list_clear(cpd_list *list)
 {
     if(list->vector && list->size)
     {
-        free(list->vector);
+        cpd_free(list->vector);
     }
     list->vector = NULL;
     list->size   = 0;
@@ -0,0 +1,274 @@
+/*
+ // Copyright (c) 2015-2016-2016 Pierre Guillot.
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+*/
+
+// The benchmarks print their timings in milliseconds, they are only meaningful compared
+// with the timings of another build or of another configuration on the same machine.
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cstdio>
+#include <vector>
+#include "../xpd/xpd.hpp"
+#include "directory.hpp"
+extern "C"
+{
+#include "../thread/src/thd.h"
+}
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/time.h>
+#endif
+
+#define XPD_BENCH_NOBJECTS  20000
+#define XPD_BENCH_NLOADS    8
+#define XPD_BENCH_NTHD      16
+#define XPD_BENCH_NTICKS    20000
+#define XPD_BENCH_SR        44100
+#define XPD_BENCH_NPATCHES  200
+
+static double bench_now()
+{
+#ifdef _WIN32
+    LARGE_INTEGER count, frequency;
+    QueryPerformanceCounter(&count);
+    QueryPerformanceFrequency(&frequency);
+    return double(count.QuadPart) * 1000. / double(frequency.QuadPart);
+#else
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return double(tv.tv_sec) * 1000. + double(tv.tv_usec) / 1000.;
+#endif
+}
+
+// ==================================================================================== //
+//                                          LOADING                                     //
+// ==================================================================================== //
+
+//! @brief Compares the loading of a large patch from the text and the binary formats.
+static void bench_load(std::string const& path)
+{
+    xpd::instance inst;
+    std::ofstream file((path + "/bench_load.pd").c_str());
+    file << "#N canvas 0 0 400 300 10;\n";
+    for(int i = 0; i < XPD_BENCH_NOBJECTS; ++i)
+    {
+        file << "#X obj 10 " << i << " + " << i << ";\n";
+    }
+    for(int i = 0; i < XPD_BENCH_NOBJECTS - 1; ++i)
+    {
+        file << "#X connect " << i << " 0 " << i + 1 << " 0;\n";
+    }
+    file.close();
+    if(!xpd::environment::patch_compile("bench_load.pd", path, path + "/bench_load.pdb"))
+    {
+        std::cout << "load: the patch can't be compiled.\n";
+        return;
+    }
+
+    const char* names[] = {"bench_load.pd", "bench_load.pdb"};
+    for(size_t i = 0; i < 2; ++i)
+    {
+        double const start = bench_now();
+        for(int j = 0; j < XPD_BENCH_NLOADS; ++j)
+        {
+            xpd::patch p = inst.load(names[i], path);
+            inst.close(p);
+        }
+        std::cout << "load " << names[i] << ": " << (bench_now() - start) / XPD_BENCH_NLOADS << " ms\n";
+    }
+    std::remove((path + "/bench_load.pd").c_str());
+    std::remove((path + "/bench_load.pdb").c_str());
+}
+
+// ==================================================================================== //
+//                                          INSTANCES                                   //
+// ==================================================================================== //
+
+class bench_instance : public xpd::instance
+{
+public:
+    bench_instance() : m_tie("bench-instance")
+    {
+        prepare(2, 2, XPD_BENCH_SR, 64);
+        m_patch = load("bench_instance.pd", "", "#N canvas 0 0 400 300 10;\n"
+                       "#X obj 10 10 r bench-instance;\n#X obj 10 40 osc~;\n#X obj 10 70 dac~;\n"
+                       "#X connect 0 0 1 0;\n#X connect 1 0 2 0;\n#X connect 1 0 2 1;\n");
+        for(size_t i = 0; i < 2; ++i)
+        {
+            m_inputs[i]  = m_ins[i];
+            m_outputs[i] = m_outs[i];
+            for(size_t j = 0; j < 64; ++j)
+            {
+                m_ins[i][j] = 0.f;
+            }
+        }
+    }
+    
+    ~bench_instance()
+    {
+        close(m_patch);
+    }
+    
+    //! @brief Sends a message and performs a tick, so the producer and the consumer sides
+    //! of the queue are both used.
+    static void run(bench_instance* inst)
+    {
+        std::vector<xpd::atom> frequency(1, xpd::atom(440.f));
+        for(int i = 0; i < XPD_BENCH_NTICKS; ++i)
+        {
+            inst->send(inst->m_tie, xpd::symbol("float"), frequency);
+            inst->perform(64, 2, inst->m_inputs, 2, inst->m_outputs);
+        }
+    }
+    
+private:
+    xpd::tie            m_tie;
+    xpd::patch          m_patch;
+    xpd::sample         m_ins[2][64];
+    xpd::sample         m_outs[2][64];
+    const xpd::sample*  m_inputs[2];
+    xpd::sample*        m_outputs[2];
+};
+
+//! @brief Compares the time of the ticks of one instance alone and of several instances
+//! performed in parallel.
+//! @details The instances share the lock of the environment, the difference between the
+//! two timings grows with the false sharing between the instances, it should be compared
+//! with a build where the managers of the instances aren't aligned on the cache lines.
+static void bench_instances()
+{
+    bench_instance* inst[XPD_BENCH_NTHD];
+    thd_thread thd[XPD_BENCH_NTHD];
+    for(size_t i = 0; i < XPD_BENCH_NTHD; ++i)
+    {
+        inst[i] = new bench_instance();
+    }
+    
+    double start = bench_now();
+    bench_instance::run(inst[0]);
+    std::cout << "instances 1: " << (bench_now() - start) / XPD_BENCH_NTICKS << " ms per tick\n";
+    
+    start = bench_now();
+    for(size_t i = 0; i < XPD_BENCH_NTHD; ++i)
+    {
+        thd_thread_detach(thd+i, (thd_thread_method)(&bench_instance::run), inst[i]);
+    }
+    for(size_t i = 0; i < XPD_BENCH_NTHD; ++i)
+    {
+        thd_thread_join(thd+i);
+    }
+    std::cout << "instances " << XPD_BENCH_NTHD << ": " << (bench_now() - start) / (XPD_BENCH_NTICKS * XPD_BENCH_NTHD) << " ms per tick\n";
+    
+    for(size_t i = 0; i < XPD_BENCH_NTHD; ++i)
+    {
+        delete inst[i];
+    }
+}
+
+// ==================================================================================== //
+//                                          HUGE PAGES                                  //
+// ==================================================================================== //
+
+//! @brief Compares the ticks of a patch that reads a long delay line at random positions
+//! with and without the huge pages.
+//! @details The TLB misses can be counted by running the benchmark with a profiler such
+//! as "perf stat -e dTLB-load-misses" on Linux.
+static void bench_huge_pages()
+{
+    xpd::sample ins[2][64];
+    xpd::sample outs[2][64];
+    const xpd::sample* inputs[2]  = {ins[0], ins[1]};
+    xpd::sample* outputs[2]       = {outs[0], outs[1]};
+    for(size_t i = 0; i < 2; ++i)
+    {
+        for(size_t j = 0; j < 64; ++j)
+        {
+            ins[i][j] = 0.f;
+        }
+    }
+    for(int huge = 0; huge < 2; ++huge)
+    {
+        xpd::instance::config c;
+        c.ninputs       = 2;
+        c.noutputs      = 2;
+        c.samplerate    = XPD_BENCH_SR;
+        c.huge_pages    = bool(huge);
+        xpd::instance inst(c);
+        size_t const advised = xpd::environment::huge_pages_memory();
+        xpd::patch p = inst.load("bench_delay.pd", "", "#N canvas 0 0 400 300 10;\n"
+                                 "#X obj 10 10 noise~;\n#X obj 10 40 delwrite~ bench-delay 60000;\n"
+                                 "#X obj 100 40 *~ 30000;\n#X obj 100 70 +~ 30000;\n"
+                                 "#X obj 100 100 delread4~ bench-delay;\n#X obj 100 130 dac~;\n"
+                                 "#X connect 0 0 1 0;\n#X connect 0 0 2 0;\n#X connect 2 0 3 0;\n"
+                                 "#X connect 3 0 4 0;\n#X connect 4 0 5 0;\n#X connect 4 0 5 1;\n");
+        double const start = bench_now();
+        for(int i = 0; i < XPD_BENCH_NTICKS; ++i)
+        {
+            inst.perform(64, 2, inputs, 2, outputs);
+        }
+        std::cout << "huge pages " << (huge ? "on" : "off") << ": "
+        << (bench_now() - start) / XPD_BENCH_NTICKS << " ms per tick, "
+        << xpd::environment::huge_pages_memory() - advised << " bytes advised\n";
+        inst.close(p);
+    }
+}
+
+// ==================================================================================== //
+//                                          REBUILD                                     //
+// ==================================================================================== //
+
+//! @brief Measures the rebuild of the DSP chain against the number of patches loaded in
+//! the instance.
+//! @details Loading or closing a patch sorts the whole DSP chain again, and so does a
+//! preparation that changes the sample rate, the timings grow with the number of patches.
+static void bench_rebuild()
+{
+    std::string const text = "#N canvas 0 0 400 300 10;\n"
+    "#X obj 10 10 osc~ 440;\n#X obj 10 40 *~ 0.1;\n#X obj 10 70 dac~;\n"
+    "#X connect 0 0 1 0;\n#X connect 1 0 2 0;\n#X connect 1 0 2 1;\n";
+    xpd::instance inst;
+    inst.prepare(2, 2, XPD_BENCH_SR, 64);
+    std::vector<xpd::patch> patches;
+    for(size_t n = 1; n <= XPD_BENCH_NPATCHES; n *= 2)
+    {
+        while(patches.size() < n)
+        {
+            patches.push_back(inst.load("bench_rebuild.pd", "", text));
+        }
+        double start = bench_now();
+        for(int i = 0; i < XPD_BENCH_NLOADS; ++i)
+        {
+            xpd::patch p = inst.load("bench_rebuild.pd", "", text);
+            inst.close(p);
+        }
+        double const load = (bench_now() - start) / XPD_BENCH_NLOADS;
+        start = bench_now();
+        for(int i = 0; i < XPD_BENCH_NLOADS; ++i)
+        {
+            inst.prepare(2, 2, (i % 2) ? XPD_BENCH_SR : XPD_BENCH_SR * 2, 64);
+        }
+        std::cout << "rebuild " << n << " patches: " << load << " ms per load and close, "
+        << (bench_now() - start) / XPD_BENCH_NLOADS << " ms per preparation\n";
+    }
+    for(size_t i = 0; i < patches.size(); ++i)
+    {
+        inst.close(patches[i]);
+    }
+}
+
+int main(int argc, char* const argv[])
+{
+    xpd::environment::initialize();
+    std::string const path = oshelper::directory::current().fullpath();
+    bench_load(path);
+    bench_instances();
+    bench_huge_pages();
+    bench_rebuild();
+    xpd::environment::clear();
+    return 0;
+}
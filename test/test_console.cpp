@@ -5,6 +5,7 @@
 */
 
 #include <iostream>
+#include <cstdio>
 #include "test.hpp"
 extern "C"
 {
@@ -17,9 +18,9 @@ extern "C"
 class console_tester : public xpd::instance, public xpd::console::history
 {
 public:
-    void receive(xpd::console::post const& post) xpd_final
+    void receive(xpd::console::level type, char const* text, size_t repeat) xpd_final
     {
-        xpd::console::history::add(post);
+        xpd::console::history::add(type, text, repeat);
     }
     
     static void generate(console_tester* inst)
@@ -35,6 +36,15 @@ public:
     }
 };
 
+static void console_test_write(xpd::console::history* history)
+{
+    for(size_t i = 0; i < XPD_TEST_NLOOP; i++)
+    {
+        history->add(xpd::console::post(xpd::console::log,    "log"));
+        history->add(xpd::console::post(xpd::console::error,  "error"));
+    }
+}
+
 TEST_CASE("console", "[console]")
 {
     console_tester  inst[XPD_TEST_NTHD];
@@ -238,6 +248,115 @@ TEST_CASE("console", "[console]")
             }
         }
     }
+    
+    SECTION("level")
+    {
+        console_tester t;
+        CHECK(t.get_post_level() == xpd::console::log);
+        t.set_post_level(xpd::console::error);
+        CHECK(t.get_post_level() == xpd::console::error);
+        t.send(xpd::console::post(xpd::console::log,    "log"));
+        t.send(xpd::console::post(xpd::console::normal, "normal"));
+        t.send(xpd::console::post(xpd::console::error,  "error"));
+        t.send(xpd::console::post(xpd::console::fatal,  "fatal"));
+        CHECK(t.get_number_of_posts(xpd::console::all) == 2);
+        CHECK(t.get_number_of_posts(xpd::console::log) == 0);
+        CHECK(t.get_number_of_posts(xpd::console::normal) == 0);
+        t.set_post_level(xpd::console::all);
+        CHECK(t.get_post_level() == xpd::console::log);
+    }
+    
+    SECTION("capacity")
+    {
+        xpd::console::history h(6);
+        CHECK(h.capacity() == 6);
+        h.add(xpd::console::post(xpd::console::fatal,  "fatal"));
+        h.add(xpd::console::post(xpd::console::error,  "error"));
+        for(size_t i = 0; i < 6; ++i)
+        {
+            h.add(xpd::console::post(xpd::console::log, "log"));
+        }
+        CHECK(h.get_number_of_posts(xpd::console::all) == 6);
+        CHECK(h.get_number_of_posts(xpd::console::fatal) == 0);
+        CHECK(h.get_number_of_posts(xpd::console::error) == 0);
+        CHECK(h.get_number_of_posts(xpd::console::log) == 6);
+        CHECK(h.get_number_of_posts_to_level(xpd::console::error) == 0);
+        
+        h.add(xpd::console::post(xpd::console::error,  "error"));
+        CHECK(h.get_number_of_posts(xpd::console::all) == 6);
+        CHECK(h.get_number_of_posts(xpd::console::log) == 5);
+        CHECK(h.get_post(5, xpd::console::all).text == std::string("error"));
+        CHECK(h.get_post(0, xpd::console::error).text == std::string("error"));
+        CHECK(h.get_post_to_level(0, xpd::console::normal).text == std::string("error"));
+        CHECK(h.get_number_of_posts_to_level(xpd::console::fatal) == 0);
+        
+        h.clear();
+        CHECK(h.get_number_of_posts(xpd::console::all) == 0);
+        CHECK(h.get_number_of_posts(xpd::console::error) == 0);
+    }
+    
+    SECTION("repeat")
+    {
+        xpd::console::history h;
+        h.add(xpd::console::post(xpd::console::error,  "error"));
+        h.add(xpd::console::post(xpd::console::error,  "error", 41));
+        h.add(xpd::console::post(xpd::console::normal, "normal", 2));
+        CHECK(h.get_number_of_posts(xpd::console::all) == 2);
+        CHECK(h.get_post(0, xpd::console::all).repeat == 41);
+        CHECK(h.get_post(1, xpd::console::all).repeat == 2);
+        h.add(xpd::console::post(xpd::console::error,  "error"));
+        h.add(xpd::console::post(xpd::console::error,  "error"));
+        CHECK(h.get_number_of_posts(xpd::console::error) == 3);
+        h.add(xpd::console::error, "error", 2);
+        h.add(xpd::console::log, "log");
+        CHECK(h.get_number_of_posts(xpd::console::error) == 3);
+        CHECK(h.get_post(2, xpd::console::error).repeat == 2);
+        CHECK(h.get_post(0, xpd::console::log).text == std::string("log"));
+    }
+    
+    SECTION("overflow")
+    {
+        char text[16];
+        xpd::console::history h(20);
+        for(int i = 0; i < 40; ++i)
+        {
+            std::sprintf(text, "%i", i);
+            h.add(xpd::console::post(xpd::console::log, text));
+        }
+        CHECK(h.get_number_of_posts(xpd::console::all) == 20);
+        CHECK(h.get_post(0, xpd::console::all).text == std::string("20"));
+        CHECK(h.get_post(19, xpd::console::all).text == std::string("39"));
+        CHECK(h.get_number_of_dropped_posts() == 8);
+        CHECK(h.get_sequence() == 32);
+    }
+    
+    SECTION("concurrent")
+    {
+        xpd::console::history h;
+        std::vector<xpd::console::post> posts;
+        size_t seq = 0, count = 0;
+        for(size_t i = 0; i < XPD_TEST_NTHD; ++i)
+        {
+            thd_thread_detach(thd+i, (thd_thread_method)(&console_test_write), &h);
+        }
+        for(size_t i = 0; i < XPD_TEST_NLOOP; ++i)
+        {
+            seq = h.get_posts_since(seq, posts);
+            count += posts.size();
+        }
+        for(size_t i = 0; i < XPD_TEST_NTHD; ++i)
+        {
+            thd_thread_join(thd+i);
+        }
+        seq = h.get_posts_since(seq, posts);
+        count += posts.size();
+        CHECK(h.get_number_of_dropped_posts() == 0);
+        CHECK(seq == XPD_TEST_NTHD * XPD_TEST_NLOOP * 2);
+        CHECK(count == XPD_TEST_NTHD * XPD_TEST_NLOOP * 2);
+        CHECK(h.get_number_of_posts(xpd::console::error) == XPD_TEST_NTHD * XPD_TEST_NLOOP);
+        CHECK(h.get_posts_since(seq, posts) == seq);
+        CHECK(posts.empty());
+    }
 }
 
 #undef XPD_TEST_NLOOP
@@ -12,6 +12,8 @@
 extern "C"
 {
 #include "../thread/src/thd.h"
+#include "../cpd/cpd.h"
+int ugen_getsortno(void);
 }
 
 #define XPD_TEST_NLOOP      16
@@ -322,8 +324,285 @@ TEST_CASE("instance", "[instance post]")
     }
 }
 
+TEST_CASE("instance config", "[instance]")
+{
+    xpd::environment::huge_pages(true);
+    CHECK(xpd::instance::config().huge_pages);
+    xpd::environment::huge_pages(false);
+    CHECK(!xpd::instance::config().huge_pages);
+    
+    xpd::instance::config c;
+    c.message_capacity  = 16;
+    c.midi_capacity     = 16;
+    c.ninputs           = XPD_TEST_NINS;
+    c.noutputs          = XPD_TEST_NOUTS;
+    c.samplerate        = XPD_TEST_SR;
+    c.lock_memory       = true;
+    c.huge_pages        = true;
+    xpd::instance inst(c);
+    CHECK(inst.samplerate() == XPD_TEST_SR);
+    
+    // The delay line is allocated by the sorting of the chain after the locking.
+    size_t const initial = xpd::environment::locked_memory();
+    xpd::patch p = inst.load("lock.pd", "", "#N canvas 0 0 400 300 10;\n#X obj 10 10 delwrite~ lock-delay 1000;\n");
+    REQUIRE(bool(p));
+    size_t const loaded = xpd::environment::locked_memory();
+    CHECK(loaded > initial);
+    inst.unlock_memory();
+    CHECK(xpd::environment::locked_memory() < loaded);
+    // The memory allocated before is locked in place.
+    CHECK(inst.lock_memory());
+    CHECK(xpd::environment::locked_memory() >= loaded);
+    inst.close(p);
+    CHECK(xpd::environment::locked_memory() < loaded);
+}
+
+#ifdef __linux__
+TEST_CASE("instance huge pages", "[instance]")
+{
+    xpd::instance::config c;
+    c.huge_pages = true;
+    xpd::instance inst(c);
+    xpd::patch p = inst.load("huge.pd", "", "#N canvas 0 0 400 300 10;\n#N canvas 0 0 450 300 (subpatch) 0;\n#X array huge-array 8192 float 0;\n#X coords 0 1 8192 -1 200 140 1;\n#X restore 10 10 graph;\n");
+    REQUIRE(bool(p));
+    
+    // The array is resized at runtime, like the soundfiler does, so it is advised then.
+    size_t const initial = xpd::environment::huge_pages_memory();
+    std::vector<xpd::atom> size(1, xpd::atom(1048576.f));
+    inst.send(xpd::tie("huge-array"), xpd::symbol("resize"), size);
+    inst.perform(64, 0, xpd_nullptr, 0, xpd_nullptr);
+    CHECK(xpd::environment::huge_pages_memory() > initial);
+    inst.close(p);
+    CHECK(xpd::environment::huge_pages_memory() == initial);
+}
+#endif
+
+TEST_CASE("instance async free", "[instance]")
+{
+    xpd::instance::config c;
+    c.async_free = true;
+    {
+        xpd::instance inst(c);
+        xpd::patch p = inst.load("async.pd", "", "#N canvas 0 0 400 300 10;\n#N canvas 0 0 450 300 (subpatch) 0;\n#X array async-array 8192 float 0;\n#X coords 0 1 8192 -1 200 140 1;\n#X restore 10 10 graph;\n");
+        REQUIRE(bool(p));
+    }
+    // The patch has been closed with the instance but the memory of its array is freed later.
+    CHECK(xpd::environment::collect() > 0);
+    CHECK(xpd::environment::collect() == 0);
+}
+
+TEST_CASE("instance dsp state", "[instance]")
+{
+    xpd::sample ins[2][64];
+    xpd::sample outs[2][64];
+    const xpd::sample* inputs[2] = {ins[0], ins[1]};
+    xpd::sample* outputs[2] = {outs[0], outs[1]};
+    for(int i = 0; i < 64; ++i)
+    {
+        ins[0][i] = ins[1][i] = 1.f;
+    }
+    
+    xpd::instance inst;
+    inst.prepare(2, 2, XPD_TEST_SR, 64);
+    xpd::patch p = inst.load("test_dsp.pd", "");
+    REQUIRE(bool(p));
+    inst.perform(64, 2, inputs, 2, outputs);
+    CHECK(outs[1][0] == 1.f);
+    
+    // The patches can stop the DSP, so the preparation must start it again.
+    std::vector<xpd::atom> off(1, xpd::atom(0.f));
+    inst.send(xpd::tie("pd"), xpd::symbol("dsp"), off);
+    inst.perform(64, 2, inputs, 2, outputs);
+    CHECK(outs[1][0] == 0.f);
+    inst.prepare(2, 2, XPD_TEST_SR, 64);
+    inst.perform(64, 2, inputs, 2, outputs);
+    CHECK(outs[1][0] == 1.f);
+    inst.close(p);
+}
+
+class post_tester : public xpd::instance
+{
+public:
+    post_tester() : m_tie("test-post-send")
+    {
+        xpd::instance::prepare(0, 0, XPD_TEST_SR, 64);
+        m_patch = xpd::instance::load("test_post_filter.pd", "", "#N canvas 0 0 450 300 10;\n"
+                                      "#X obj 10 10 r test-post-send;\n"
+                                      "#X obj 10 40 print xpd;\n"
+                                      "#X connect 0 0 1 0;\n");
+    }
+    
+    ~post_tester()
+    {
+        xpd::instance::close(m_patch);
+    }
+    
+    void receive(xpd::console::post const& post) xpd_final
+    {
+        m_posts.push_back(post);
+    }
+    
+    //! @brief Sends bangs to the print object and performs one tick.
+    void print(size_t nbangs)
+    {
+        for(size_t i = 0; i < nbangs; ++i)
+        {
+            xpd::instance::send(m_tie, xpd::symbol("bang"), std::vector<xpd::atom>());
+        }
+        xpd::instance::perform(64, 0, xpd_nullptr, 0, xpd_nullptr);
+    }
+    
+    //! @brief Performs a bit more than one second so the repeated posts are flushed.
+    void wait()
+    {
+        for(int i = 0; i < XPD_TEST_SR / 64 + 1; ++i)
+        {
+            xpd::instance::perform(64, 0, xpd_nullptr, 0, xpd_nullptr);
+        }
+    }
+    
+    xpd::patch  m_patch;
+    xpd::tie    m_tie;
+    std::vector<xpd::console::post> m_posts;
+};
+
+TEST_CASE("instance post", "[instance]")
+{
+    post_tester inst;
+    REQUIRE(bool(inst.m_patch));
+    
+    SECTION("collapse")
+    {
+        inst.set_post_collapse(true);
+        inst.print(5);
+        REQUIRE(inst.m_posts.size() == 1);
+        CHECK(inst.m_posts[0].text == "xpd: bang");
+        CHECK(inst.m_posts[0].repeat == 0);
+        inst.wait();
+        REQUIRE(inst.m_posts.size() == 2);
+        CHECK(inst.m_posts[1].text == "xpd: bang");
+        CHECK(inst.m_posts[1].repeat == 4);
+        inst.set_post_collapse(false);
+        inst.print(2);
+        CHECK(inst.m_posts.size() == 4);
+    }
+    
+    SECTION("budget")
+    {
+        inst.set_post_budget(2);
+        inst.print(5);
+        CHECK(inst.m_posts.size() == 2);
+        inst.wait();
+        REQUIRE(inst.m_posts.size() == 3);
+        CHECK(inst.m_posts[2].type == xpd::console::error);
+        CHECK(inst.m_posts[2].text == "3 posts dropped");
+        inst.print(1);
+        CHECK(inst.m_posts.size() == 4);
+        inst.set_post_budget(0);
+        inst.print(5);
+        CHECK(inst.m_posts.size() == 9);
+        
+        // The posts made outside the perform, while loading, aren't limited.
+        inst.set_post_budget(1);
+        xpd::patch p = inst.load("test_post_load.pd", "", "#N canvas 0 0 450 300 10;\n"
+                                 "#X obj 10 10 loadbang;\n#X obj 10 40 print load1;\n"
+                                 "#X obj 10 70 print load2;\n#X obj 10 100 print load3;\n"
+                                 "#X connect 0 0 1 0;\n#X connect 0 0 2 0;\n#X connect 0 0 3 0;\n");
+        CHECK(inst.m_posts.size() == 12);
+        inst.close(p);
+        inst.set_post_budget(0);
+    }
+}
+
 #undef XPD_TEST_NLOOP
 
+struct pool_instance
+{
+    cpd_instance    instance;
+    int             value;
+};
 
+static size_t c_pool_posts = 0;
 
+static void pool_post(cpd_instance* instance, cpd_post post)
+{
+    ++c_pool_posts;
+}
+
+static void pool_tick(cpd_instance* instance)
+{
+    cpd_instance_dsp_perform(instance, 64, 0, xpd_nullptr, 0, xpd_nullptr);
+}
 
+static void pool_bang(cpd_instance* instance)
+{
+    cpd_message message;
+    message.tie         = cpd_tie_create("test-pool-send");
+    message.selector    = cpd_symbol_create("bang");
+    cpd_list_init(&message.list, 0);
+    cpd_instance_message_send(instance, message);
+}
+
+TEST_CASE("instance pool", "[instance]")
+{
+    static const char text[] = "#N canvas 0 0 400 300 10;\n#X obj 10 10 r test-pool-send;\n#X obj 10 40 print pool;\n#X connect 0 0 1 0;\n";
+    cpd_instance_pool* pool = cpd_instance_pool_new(sizeof(pool_instance), 1, 0, 0, XPD_TEST_SR);
+    REQUIRE(pool);
+    
+    SECTION("reuse")
+    {
+        cpd_instance* i1 = cpd_instance_pool_acquire(pool);
+        REQUIRE(i1);
+        CHECK(cpd_instance_get_samplerate(i1) == XPD_TEST_SR);
+        cpd_instance* i2 = cpd_instance_pool_acquire(pool);
+        REQUIRE(i2);
+        CHECK(i2 != i1);
+        CHECK(cpd_instance_get_samplerate(i2) == XPD_TEST_SR);
+        cpd_instance_pool_release(pool, i1);
+        cpd_instance_pool_release(pool, i2);
+        CHECK(cpd_instance_pool_acquire(pool) == i1);
+        cpd_instance_pool_release(pool, i1);
+    }
+    
+    SECTION("reset")
+    {
+        cpd_instance* i1 = cpd_instance_pool_acquire(pool);
+        REQUIRE(i1);
+        reinterpret_cast<pool_instance *>(i1)->value = 42;
+        REQUIRE(cpd_instance_patch_load_from_memory(i1, "pool.pd", "", text, sizeof(text) - 1));
+        cpd_instance_post_sethook(i1, pool_post);
+        cpd_instance_post_setcollapse(i1, 1);
+        cpd_instance_post_setbudget(i1, 1);
+        c_pool_posts = 0;
+        pool_tick(i1);
+        pool_bang(i1);
+        pool_bang(i1);
+        pool_bang(i1);
+        pool_tick(i1);
+        CHECK(c_pool_posts == 1);
+        // The repeated posts, a queued message and an open batch are left to the pool.
+        pool_bang(i1);
+        cpd_instance_begin_batch(i1);
+        cpd_instance_pool_release(pool, i1);
+        
+        cpd_instance* i2 = cpd_instance_pool_acquire(pool);
+        REQUIRE(i2 == i1);
+        CHECK(reinterpret_cast<pool_instance *>(i2)->value == 0);
+        CHECK(cpd_instance_post_getlevel(i2) == cpd_post_log);
+        cpd_instance_post_sethook(i2, pool_post);
+        cpd_instance_post_setbudget(i2, 1);
+        c_pool_posts = 0;
+        pool_tick(i2);
+        CHECK(c_pool_posts == 0);
+        // The batch has been canceled so loading a patch sorts the DSP chain.
+        int const sortno = ugen_getsortno();
+        REQUIRE(cpd_instance_patch_load_from_memory(i2, "pool.pd", "", text, sizeof(text) - 1));
+        CHECK(ugen_getsortno() == sortno + 1);
+        pool_bang(i2);
+        pool_tick(i2);
+        CHECK(c_pool_posts == 1);
+        cpd_instance_pool_release(pool, i2);
+    }
+    
+    cpd_instance_pool_free(pool);
+}
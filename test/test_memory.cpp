@@ -0,0 +1,138 @@
+/*
+ // Copyright (c) 2015-2016-2016 Pierre Guillot.
+ // For information on usage and redistribution, and for a DISCLAIMER OF ALL
+ // WARRANTIES, see the file, "LICENSE.txt," in this distribution.
+*/
+
+#include <cstdlib>
+#include <cstring>
+#include "test.hpp"
+extern "C"
+{
+#include "../cpd/cpd.h"
+void *getbytes(size_t nbytes);
+void *resizebytes(void *x, size_t oldsize, size_t newsize);
+void freebytes(void *x, size_t nbytes);
+}
+
+static size_t c_allocations = 0;
+static size_t c_deallocations = 0;
+
+// The allocator offsets its blocks, so freeing a block with another allocator crashes.
+#define XPD_TEST_OFFSET 16
+
+static void* memory_allocate(size_t size)
+{
+    ++c_allocations;
+    char* ptr = static_cast<char*>(malloc(size + XPD_TEST_OFFSET));
+    return ptr ? ptr + XPD_TEST_OFFSET : xpd_nullptr;
+}
+
+static void* memory_reallocate(void* ptr, size_t size)
+{
+    ++c_allocations;
+    char* nptr = static_cast<char*>(realloc(static_cast<char*>(ptr) - XPD_TEST_OFFSET, size + XPD_TEST_OFFSET));
+    return nptr ? nptr + XPD_TEST_OFFSET : xpd_nullptr;
+}
+
+static void memory_deallocate(void* ptr)
+{
+    ++c_deallocations;
+    free(static_cast<char*>(ptr) - XPD_TEST_OFFSET);
+}
+
+class memory_tester : public xpd::instance
+{
+public:
+    
+    //! @brief Performs one tick and returns the number of allocations made.
+    size_t tick()
+    {
+        size_t const count = xpd::environment::perform_allocations();
+        xpd::instance::perform(64, 0, xpd_nullptr, 0, xpd_nullptr);
+        return xpd::environment::perform_allocations() - count;
+    }
+};
+
+TEST_CASE("memory", "[memory]")
+{
+    SECTION("allocator")
+    {
+        cpd_allocator const allocator = {memory_allocate, memory_reallocate, memory_deallocate};
+        cpd_memory_setallocator(&allocator);
+        c_allocations = 0;
+        char* ptr = static_cast<char*>(getbytes(64));
+        REQUIRE(ptr);
+        CHECK(c_allocations == 1);
+        CHECK(ptr[63] == 0);
+        ptr = static_cast<char*>(resizebytes(ptr, 64, 128));
+        REQUIRE(ptr);
+        CHECK(c_allocations == 2);
+        CHECK(ptr[127] == 0);
+        freebytes(ptr, 128);
+        {
+            xpd::instance inst;
+            size_t const count = c_allocations;
+            xpd::patch p = inst.load("test_dsp.pd", "");
+            REQUIRE(bool(p));
+            CHECK(c_allocations > count);
+            inst.close(p);
+        }
+        
+        // The blocks are freed by the allocator that allocated them.
+        ptr = static_cast<char*>(getbytes(64));
+        cpd_memory_setallocator(xpd_nullptr);
+        c_allocations   = 0;
+        c_deallocations = 0;
+        char* other = static_cast<char*>(getbytes(64));
+        freebytes(ptr, 64);
+        CHECK(c_deallocations == 1);
+        ptr = static_cast<char*>(resizebytes(other, 64, 128));
+        REQUIRE(ptr);
+        cpd_memory_setallocator(&allocator);
+        freebytes(ptr, 128);
+        CHECK(c_allocations == 0);
+        CHECK(c_deallocations == 1);
+        cpd_memory_setallocator(xpd_nullptr);
+    }
+    
+    SECTION("perform allocations")
+    {
+        memory_tester inst;
+        xpd::patch p = inst.load("alloc.pd", "", "#N canvas 0 0 400 300 10;\n#X obj 10 10 r test-alloc-send;\n#X obj 10 40 list prepend;\n#X connect 0 0 1 1;\n");
+        REQUIRE(bool(p));
+        inst.prepare(0, 0, 44100, 64);
+        inst.tick();
+        size_t const idle = inst.tick();
+        std::vector<xpd::atom> vec(3, xpd::atom(1.f));
+        inst.send(xpd::tie("test-alloc-send"), xpd::symbol("list"), vec);
+        CHECK(inst.tick() > idle);
+        inst.close(p);
+    }
+    
+    SECTION("pool allocator")
+    {
+        cpd_allocator const* pool = cpd_memory_getpoolallocator();
+        REQUIRE(pool);
+        cpd_memory_reservepool(65536);
+        char* p1 = static_cast<char*>(pool->allocate(24));
+        REQUIRE(p1);
+        pool->deallocate(p1);
+        char* p2 = static_cast<char*>(pool->allocate(30));
+        CHECK(p2 == p1);
+        p2 = static_cast<char*>(pool->reallocate(p2, 20));
+        CHECK(p2 == p1);
+        for(int i = 0; i < 20; ++i)
+        {
+            p2[i] = char(i);
+        }
+        p2 = static_cast<char*>(pool->reallocate(p2, 8192));
+        REQUIRE(p2);
+        CHECK(p2[19] == 19);
+        p2 = static_cast<char*>(pool->reallocate(p2, 100));
+        REQUIRE(p2);
+        CHECK(p2[0] == 0);
+        CHECK(p2[19] == 19);
+        pool->deallocate(p2);
+    }
+}
@@ -5,9 +5,37 @@
 */
 
 #include "test.hpp"
+#include <cstdio>
+
+extern "C"
+{
+    int ugen_getsortno(void);
+}
 
 class pacth_tester : public xpd::instance
 {
+public:
+    
+    //! @brief Performs one tick so the pending values of the guis are applied.
+    void tick()
+    {
+        xpd::instance::prepare(0, 0, 44100, 64);
+        xpd::instance::perform(64, 0, xpd_nullptr, 0, xpd_nullptr);
+    }
+};
+
+//! @brief Takes a snapshot of the guis of its patch from the post hook, while the
+//! environment is already locked.
+class snapshot_tester : public pacth_tester
+{
+public:
+    xpd::patch                  m_patch;
+    std::vector<xpd::gui_state> m_states;
+    
+    void receive(xpd::console::post const& post) xpd_final
+    {
+        m_patch.snapshot(m_states);
+    }
 };
 
 static void test_gui_int(xpd::patch p, xpd::object o)
@@ -185,7 +213,360 @@ TEST_CASE("patch", "[patch]")
             
         }
         inst.close(p1);
-    }    
+    }
+    
+    SECTION("Bounds")
+    {
+        xpd::patch p1 = inst.load("test_patch.pd", "");
+        REQUIRE(bool(p1));
+        std::vector<xpd::object> objects(p1.objects());
+        std::vector<xpd::rectangle> bounds(p1.bounds());
+        REQUIRE(bounds.size() == objects.size());
+        for(size_t i = 0; i < objects.size(); ++i)
+        {
+            xpd::rectangle const rect = objects[i].bounds();
+            CHECK(bounds[i].x == objects[i].x());
+            CHECK(bounds[i].y == objects[i].y());
+            CHECK(bounds[i].width == objects[i].width());
+            CHECK(bounds[i].height == objects[i].height());
+            CHECK(rect.x == bounds[i].x);
+            CHECK(rect.y == bounds[i].y);
+            CHECK(rect.width == bounds[i].width);
+            CHECK(rect.height == bounds[i].height);
+        }
+        inst.close(p1);
+    }
+    
+    SECTION("Iteration")
+    {
+        xpd::patch p1 = inst.load("test_patch.pd", "");
+        REQUIRE(bool(p1));
+        std::vector<xpd::object> objects(p1.objects());
+        size_t count = 0;
+        for(xpd::patch::iterator it = p1.begin(); it != p1.end(); ++it, ++count)
+        {
+            REQUIRE(count < objects.size());
+            CHECK((*it).name() == objects[count].name());
+        }
+        CHECK(count == objects.size());
+        
+        count = 0;
+        for(xpd::patch::iterator it = p1.begin(xpd::patch::filter::guis()); it != p1.end(); ++it, ++count)
+        {
+            xpd::gui g(*it);
+            CHECK(g.receive_tie().name() == g.name() + "r");
+        }
+        CHECK(count == 9);
+        
+        count = 0;
+        for(xpd::patch::iterator it = p1.begin(xpd::patch::filter::name(xpd::symbol("tgl"))); it != p1.end(); it++, ++count)
+        {
+            CHECK(it->name() == "tgl");
+        }
+        CHECK(count == 1);
+        
+        xpd::patch::iterator it = p1.begin(xpd::patch::filter::receive_tie(xpd::tie("hslr")));
+        REQUIRE(it != p1.end());
+        CHECK((*it).name() == "hsl");
+        CHECK(++it == p1.end());
+        CHECK(p1.begin(xpd::patch::filter::receive_tie(xpd::tie("zaza"))) == p1.end());
+        inst.close(p1);
+    }
+    
+    SECTION("Search Path")
+    {
+        xpd::patch p1 = inst.load("test_patch.pd", "");
+        REQUIRE(bool(p1));
+        inst.close(p1);
+        xpd::environment::searchpath_refresh();
+        p1 = inst.load("test_patch.pd", "");
+        REQUIRE(bool(p1));
+        std::string const path = p1.path();
+        inst.close(p1);
+        CHECK(!bool(inst.load("zaza.pd", "")));
+        
+        // The missing file is cached, so it isn't found until the cache is refreshed.
+        CHECK(!bool(inst.load("test_searchpath.pd", "")));
+        std::FILE* file = std::fopen((path + "/test_searchpath.pd").c_str(), "w");
+        REQUIRE(file);
+        std::fputs("#N canvas 0 0 450 300 10;\n", file);
+        std::fclose(file);
+        CHECK(!bool(inst.load("test_searchpath.pd", "")));
+        xpd::environment::searchpath_refresh();
+        p1 = inst.load("test_searchpath.pd", "");
+        REQUIRE(bool(p1));
+        CHECK(p1.path() == path);
+        inst.close(p1);
+        
+        // The stale entry of the removed file isn't probed again.
+        std::remove((path + "/test_searchpath.pd").c_str());
+        CHECK(!bool(inst.load("test_searchpath.pd", "")));
+        CHECK(!bool(inst.load("test_searchpath.pd", "")));
+    }
+    
+    SECTION("Cache")
+    {
+        xpd::patch p1 = inst.load("test_patch.pd", "");
+        REQUIRE(bool(p1));
+        xpd::patch p2 = inst.load("test_patch.pd", "");
+        REQUIRE(bool(p2));
+        CHECK(p1.name() == p2.name());
+        CHECK(p1.path() == p2.path());
+        CHECK(p1.unique_id() != p2.unique_id());
+        CHECK(p1.objects(xpd::symbol("vsl")).size() == p2.objects(xpd::symbol("vsl")).size());
+        inst.close(p2);
+        inst.close(p1);
+    }
+    
+    SECTION("Memory")
+    {
+        xpd::patch p1 = inst.load("memory.pd", "/virtual", "#N canvas 100 100 400 150 10;\n#X obj 10 10 receive zaza;\n");
+        REQUIRE(bool(p1));
+        CHECK(p1.name() == "memory.pd");
+        CHECK(p1.path() == "/virtual");
+        CHECK(p1.width() == 400);
+        CHECK(p1.receivers(xpd::tie("zaza")).size() == 1);
+        inst.close(p1);
+        CHECK(!bool(inst.load("memory.pd", "", "")));
+    }
+    
+    SECTION("Batch")
+    {
+        xpd::patch p1, p2;
+        inst.tick();
+        int sortno = ugen_getsortno();
+        {
+            xpd::instance::batch b1(inst);
+            p1 = inst.load("test_patch.pd", "");
+            {
+                xpd::instance::batch b2(inst);
+                p2 = inst.clone(p1);
+            }
+            inst.perform(64, 0, xpd_nullptr, 0, xpd_nullptr);
+        }
+        REQUIRE(bool(p1));
+        REQUIRE(bool(p2));
+        CHECK(ugen_getsortno() == sortno + 1);
+        sortno = ugen_getsortno();
+        {
+            xpd::instance::batch b(inst);
+            inst.close(p2);
+            // The closed patch is still performed until the end of the batch.
+            inst.perform(64, 0, xpd_nullptr, 0, xpd_nullptr);
+            inst.close(p1);
+        }
+        CHECK(ugen_getsortno() == sortno + 1);
+        inst.tick();
+    }
+    
+    SECTION("Close Async")
+    {
+        xpd::patch p1 = inst.load("test_patch.pd", "");
+        REQUIRE(bool(p1));
+        xpd::patch p2 = inst.clone(p1);
+        REQUIRE(bool(p2));
+        inst.close_async(p2);
+        inst.close_async(p1);
+        CHECK(inst.collect() == 2);
+        CHECK(inst.collect() == 0);
+        
+        // The patch is freed immediately but the memory of its array is freed later.
+        xpd::patch p3 = inst.load("async.pd", "", "#N canvas 0 0 400 300 10;\n#N canvas 0 0 450 300 (subpatch) 0;\n#X array async-array 8192 float 0;\n#X coords 0 1 8192 -1 200 140 1;\n#X restore 10 10 graph;\n");
+        REQUIRE(bool(p3));
+        inst.close_async(p3);
+        CHECK(xpd::environment::collect() > 0);
+        CHECK(xpd::environment::collect() == 0);
+        CHECK(inst.collect() == 1);
+    }
+    
+    SECTION("Clone")
+    {
+        pacth_tester inst2;
+        xpd::patch p1 = inst.load("test_patch.pd", "");
+        REQUIRE(bool(p1));
+        xpd::patch p2 = inst.clone(p1);
+        REQUIRE(bool(p2));
+        xpd::patch p3 = inst2.clone(p1);
+        REQUIRE(bool(p3));
+        CHECK(p2.name() == p1.name());
+        CHECK(p3.path() == p1.path());
+        CHECK(p2.unique_id() != p1.unique_id());
+        CHECK(p3.unique_id() != p2.unique_id());
+        CHECK(p3.objects(xpd::symbol("vsl")).size() == 1);
+        inst.close(p1);
+        xpd::patch p4 = inst.clone(p2);
+        REQUIRE(bool(p4));
+        inst.close(p4);
+        inst2.close(p3);
+        inst.close(p2);
+    }
+    
+    SECTION("Binary")
+    {
+        xpd::patch p1 = inst.load("test_patch.pd", "");
+        REQUIRE(bool(p1));
+        std::string const path = p1.path();
+        REQUIRE(xpd::environment::patch_compile("test_patch.pd", path, path + "/test_patch.pdb"));
+        xpd::patch p2 = inst.load("test_patch.pdb", path);
+        REQUIRE(bool(p2));
+        CHECK(p2.width() == p1.width());
+        CHECK(p2.objects(xpd::symbol("vsl")).size() == 1);
+        CHECK(p2.receivers(xpd::tie("nbxr")).size() == 1);
+        inst.close(p2);
+        inst.close(p1);
+        std::remove((path + "/test_patch.pdb").c_str());
+        CHECK(!xpd::environment::patch_compile("zaza.pd", path, path + "/zaza.pdb"));
+    }
+    
+    SECTION("Index")
+    {
+        xpd::patch p1 = inst.load("test_patch.pd", "");
+        REQUIRE(bool(p1));
+        std::vector<xpd::object> objects(p1.objects(xpd::symbol("vsl")));
+        REQUIRE(objects.size() == 1);
+        CHECK(objects[0].name() == "vsl");
+        CHECK(p1.objects(xpd::symbol("zaza")).empty());
+        
+        objects = p1.receivers(xpd::tie("nbxr"));
+        REQUIRE(objects.size() == 1);
+        CHECK(objects[0].name() == "nbx");
+        CHECK(p1.receivers(xpd::tie("nbxs")).empty());
+        
+        objects = p1.senders(xpd::tie("tgls"));
+        REQUIRE(objects.size() == 1);
+        CHECK(objects[0].name() == "tgl");
+        CHECK(p1.senders(xpd::tie("vur")).empty());
+        inst.close(p1);
+        
+        p1 = inst.load("test_subpatch.pd", "", "#N canvas 0 0 450 300 10;\n"
+                       "#N canvas 0 0 450 300 sub 0;\n"
+                       "#X obj 10 10 r subr;\n"
+                       "#X obj 10 40 s subs;\n"
+                       "#X restore 10 10 pd sub;\n");
+        REQUIRE(bool(p1));
+        CHECK(p1.objects(xpd::symbol("canvas")).size() == 1);
+        CHECK(p1.receivers(xpd::tie("subr")).size() == 1);
+        CHECK(p1.senders(xpd::tie("subs")).size() == 1);
+        inst.close(p1);
+        
+        // The index goes stale with dynamic patching until it is rebuilt.
+        p1 = inst.load("test_dynamic.pd", "", "#N canvas 0 0 450 300 10;\n"
+                       "#X obj 10 10 r dynr;\n");
+        REQUIRE(bool(p1));
+        std::vector<xpd::atom> atoms;
+        atoms.push_back(xpd::atom(10.f));
+        atoms.push_back(xpd::atom(40.f));
+        atoms.push_back(xpd::atom(xpd::symbol("r")));
+        atoms.push_back(xpd::atom(xpd::symbol("dynr")));
+        inst.send(xpd::tie("pd-test_dynamic.pd"), xpd::symbol("obj"), atoms);
+        inst.tick();
+        CHECK(p1.receivers(xpd::tie("dynr")).size() == 1);
+        inst.reindex(p1);
+        CHECK(p1.receivers(xpd::tie("dynr")).size() == 2);
+        CHECK(p1.objects(xpd::symbol("r")).size() == 2);
+        inst.close(p1);
+    }
+    
+    SECTION("Snapshot")
+    {
+        xpd::patch p1 = inst.load("test_patch.pd", "");
+        REQUIRE(bool(p1));
+        std::vector<xpd::gui_state> states;
+        p1.snapshot(states);
+        CHECK(states.size() == 9);
+        for(size_t i = 0; i < states.size(); ++i)
+        {
+            CHECK(states[i].type == states[i].control.type());
+            CHECK(states[i].minimum == states[i].control.minimum());
+            CHECK(states[i].maximum == states[i].control.maximum());
+            CHECK(states[i].nsteps == states[i].control.nsteps());
+            CHECK(states[i].value == states[i].control.value());
+        }
+        inst.close(p1);
+        
+        snapshot_tester tester;
+        tester.m_patch = tester.load("test_snapshot.pd", "", "#N canvas 0 0 450 300 10;\n"
+                                     "#X obj 10 10 tgl 15 0 empty empty empty 17 7 0 10 -262144 -1 -1 0 1;\n"
+                                     "#X obj 10 40 r test-snapshot;\n#X obj 10 70 print snapshot;\n"
+                                     "#X connect 1 0 2 0;\n");
+        REQUIRE(bool(tester.m_patch));
+        tester.send(xpd::tie("test-snapshot"), xpd::symbol("bang"), std::vector<xpd::atom>());
+        tester.tick();
+        CHECK(tester.m_states.size() == 1);
+        tester.close(tester.m_patch);
+    }
+    
+    SECTION("Tracking")
+    {
+        xpd::patch p1 = inst.load("test_patch.pd", "");
+        REQUIRE(bool(p1));
+        std::vector<xpd::gui> guis;
+        p1.changed_guis(guis);
+        CHECK(guis.empty());
+        p1.track_guis(true);
+        p1.changed_guis(guis);
+        CHECK(guis.empty());
+        
+        std::vector<xpd::object> objects(p1.objects(xpd::symbol("hsl")));
+        REQUIRE(objects.size() == 1);
+        xpd::gui g(objects[0]);
+        g.set_value(64.f);
+        inst.tick();
+        p1.changed_guis(guis);
+        REQUIRE(guis.size() == 1);
+        CHECK(guis[0].name() == "hsl");
+        CHECK(guis[0].value() == Approx(64.f).epsilon(0.01));
+        p1.changed_guis(guis);
+        CHECK(guis.empty());
+        
+        p1.track_guis(false);
+        g.set_value(32.f);
+        inst.tick();
+        p1.changed_guis(guis);
+        CHECK(guis.empty());
+        inst.close(p1);
+        
+        // Only the guis of the main canvas are tracked.
+        p1 = inst.load("test_track.pd", "", "#N canvas 0 0 450 300 10;\n"
+                       "#X obj 10 10 tgl 15 0 empty toptgl empty 17 7 0 10 -262144 -1 -1 0 1;\n"
+                       "#N canvas 0 0 450 300 sub 0;\n"
+                       "#X obj 10 10 tgl 15 0 empty subtgl empty 17 7 0 10 -262144 -1 -1 0 1;\n"
+                       "#X restore 10 40 pd sub;\n");
+        REQUIRE(bool(p1));
+        p1.track_guis(true);
+        std::vector<xpd::atom> value(1, xpd::atom(1.f));
+        inst.send(xpd::tie("subtgl"), xpd::symbol("float"), value);
+        inst.tick();
+        p1.changed_guis(guis);
+        CHECK(guis.empty());
+        inst.send(xpd::tie("toptgl"), xpd::symbol("float"), value);
+        inst.tick();
+        p1.changed_guis(guis);
+        CHECK(guis.size() == 1);
+        p1.track_guis(false);
+        inst.close(p1);
+    }
+    
+    SECTION("Set Value")
+    {
+        xpd::patch p1 = inst.load("test_patch.pd", "");
+        REQUIRE(bool(p1));
+        std::vector<xpd::object> objects(p1.objects(xpd::symbol("hsl")));
+        REQUIRE(objects.size() == 1);
+        xpd::gui g(objects[0]);
+        CHECK_NOTHROW(g.set_value(64.f));
+        CHECK_NOTHROW(g.set_value(32.f));
+        CHECK(g.value() == Approx(1.f).epsilon(0.01));
+        inst.tick();
+        CHECK(g.value() == Approx(32.f).epsilon(0.01));
+        
+        xpd::gui::slot s = g.get_slot();
+        REQUIRE(bool(s));
+        s.set_value(16.f);
+        inst.tick();
+        CHECK(g.value() == Approx(16.f).epsilon(0.01));
+        inst.close(p1);
+    }
 }
 
 
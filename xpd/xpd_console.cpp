@@ -6,88 +6,341 @@
 
 #include "xpd_console.hpp"
 #include <cassert>
+#include <cstring>
+#include <algorithm>
+
+extern "C"
+{
+#include "../cpd/cpd_atomic.h"
+}
 
 namespace xpd
 {
+    // ==================================================================================== //
+    //                                          QUEUE                                       //
+    // ==================================================================================== //
+    
+    // A bounded multi-producer multi-consumer queue, each cell owns a sequence number that
+    // tells if the cell is free for the writers or ready for the readers. The text of the
+    // posts is copied in fixed buffers so the writers never allocate. When the queue is
+    // full, a writer evicts the oldest post once, if the queue is still full, because a
+    // reader hasn't released its cell yet, the new post is dropped. So the writers return
+    // in bounded time and the readers never lose the posts they are reading.
+    struct console::history::queue
+    {
+        static const size_t text_size = 1000ul;
+        
+        struct cell
+        {
+            cpd_atomic_int  seq;
+            level           type;
+            size_t          repeat;
+            char            text[text_size];
+        };
+        
+        cell*           cells;
+        size_t          mask;
+        cpd_atomic_int  write;
+        cpd_atomic_int  read;
+        cpd_atomic_int  dropped;
+        
+        queue(size_t capacity) : cells(xpd_nullptr), mask(15ul), write(0), read(0), dropped(0)
+        {
+            while(mask + 1ul < capacity)
+            {
+                mask = (mask << 1ul) | 1ul;
+            }
+            cells = new cell[mask + 1ul];
+            for(size_t i = 0; i <= mask; ++i)
+            {
+                cpd_atomic_int_store(&cells[i].seq, long(i));
+            }
+        }
+        
+        ~queue()
+        {
+            delete [] cells;
+        }
+        
+        bool push(level type, char const* text, size_t repeat) xpd_noexcept
+        {
+            long pos = cpd_atomic_int_load(&write);
+            bool evicted = false;
+            cell* c;
+            for(;;)
+            {
+                c = cells + (size_t(pos) & mask);
+                long const diff = cpd_atomic_int_load(&c->seq) - pos;
+                if(diff == 0)
+                {
+                    if(cpd_atomic_int_compare_exchange(&write, pos, pos + 1))
+                    {
+                        break;
+                    }
+                }
+                else if(diff < 0)
+                {
+                    cell* o;
+                    long opos;
+                    if(evicted || !pop(o, opos))
+                    {
+                        cpd_atomic_int_fetch_add(&dropped, 1);
+                        return false;
+                    }
+                    release(o, opos);
+                    cpd_atomic_int_fetch_add(&dropped, 1);
+                    evicted = true;
+                    pos = cpd_atomic_int_load(&write);
+                }
+                else
+                {
+                    pos = cpd_atomic_int_load(&write);
+                }
+            }
+            size_t size = 0ul;
+            while(size < text_size - 1ul && text[size])
+            {
+                ++size;
+            }
+            std::memcpy(c->text, text, size);
+            c->text[size] = '\0';
+            c->type     = type;
+            c->repeat   = repeat;
+            cpd_atomic_int_store(&c->seq, pos + 1);
+            return true;
+        }
+        
+        // Claims the oldest post, the cell must be released once it has been read.
+        bool pop(cell*& c, long& pos) xpd_noexcept
+        {
+            pos = cpd_atomic_int_load(&read);
+            for(;;)
+            {
+                c = cells + (size_t(pos) & mask);
+                long const diff = cpd_atomic_int_load(&c->seq) - (pos + 1);
+                if(diff == 0)
+                {
+                    if(cpd_atomic_int_compare_exchange(&read, pos, pos + 1))
+                    {
+                        return true;
+                    }
+                }
+                else if(diff < 0)
+                {
+                    return false;
+                }
+                else
+                {
+                    pos = cpd_atomic_int_load(&read);
+                }
+            }
+        }
+        
+        void release(cell* c, long pos) xpd_noexcept
+        {
+            cpd_atomic_int_store(&c->seq, pos + long(mask) + 1);
+        }
+    };
+    
+    // ==================================================================================== //
+    //                                          HISTORY                                     //
+    // ==================================================================================== //
+    
+    console::history::history(size_t capacity) :
+    m_posts(capacity ? capacity : 1ul, post(log, std::string())), m_first(0ul), m_next(0ul),
+    m_queue(new queue(capacity))
+    {
+        // The texts never exceed the size of the buffers of the queue, so they are never
+        // reallocated when the posts are merged.
+        for(size_t i = 0; i < m_posts.size(); ++i)
+        {
+            m_posts[i].text.reserve(queue::text_size);
+        }
+        for(size_t i = 0; i < 4; ++i)
+        {
+            m_levels[i].m_seqs.resize(m_posts.size());
+        }
+        for(size_t i = 0; i < 3; ++i)
+        {
+            m_to_levels[i].m_seqs.resize(m_posts.size());
+        }
+    }
     
-    console::history::history()
+    console::history::~history()
     {
-        m_counters[0] = m_counters[1] = m_counters[2] = m_counters[3] = 0ul;
-        m_posts.reserve(512);
+        delete m_queue;
+    }
+    
+    void console::history::insert(level type, char const* text, size_t repeat) const xpd_noexcept
+    {
+        if(repeat && m_next != m_first)
+        {
+            post& last = m_posts[(m_next - 1ul) % m_posts.size()];
+            if(last.type == type && last.text == text)
+            {
+                last.repeat += repeat;
+                return;
+            }
+        }
+        // The oldest post is removed from the indexes before it is overwritten, it is
+        // always the first entry of the indexes of its level.
+        if(m_next - m_first == m_posts.size())
+        {
+            size_t const otype = static_cast<size_t>(m_posts[m_first % m_posts.size()].type);
+            m_levels[otype].m_first++;
+            for(size_t i = otype; i < 3; ++i)
+            {
+                m_to_levels[i].m_first++;
+            }
+            m_first++;
+        }
+        post& p = m_posts[m_next % m_posts.size()];
+        p.type      = type;
+        p.repeat    = repeat;
+        p.text.assign(text);
+        m_levels[static_cast<size_t>(type)].push(m_next);
+        for(size_t i = static_cast<size_t>(type); i < 3; ++i)
+        {
+            m_to_levels[i].push(m_next);
+        }
+        m_next++;
+    }
+    
+    void console::history::synchronize() const xpd_noexcept
+    {
+        queue::cell* c;
+        long pos;
+        while(m_queue->pop(c, pos))
+        {
+            insert(c->type, c->text, c->repeat);
+            m_queue->release(c, pos);
+        }
     }
     
     size_t console::history::get_number_of_posts(level lvl) const xpd_noexcept
     {
+        size_t count;
+        m_mutex.lock();
+        synchronize();
         if(lvl == all)
         {
-            return m_posts.size();
+            count = m_next - m_first;
         }
-        return m_counters[static_cast<size_t>(lvl)];
+        else
+        {
+            count = m_levels[static_cast<size_t>(lvl)].size();
+        }
+        m_mutex.unlock();
+        return count;
     }
     
     size_t console::history::get_number_of_posts_to_level(level lvl) const xpd_noexcept
     {
-        if(lvl == all)
+        size_t count;
+        m_mutex.lock();
+        synchronize();
+        if(lvl == all || lvl == log)
         {
-            return m_posts.size();
+            count = m_next - m_first;
         }
-        size_t count = 0ul;
-        for(size_t i = 0ul; i <= static_cast<size_t>(lvl); ++i)
+        else
         {
-            count += m_counters[static_cast<size_t>(i)];
+            count = m_to_levels[static_cast<size_t>(lvl)].size();
         }
+        m_mutex.unlock();
         return count;
     }
     
     console::post console::history::get_post(size_t index, level lvl) const
     {
+        size_t seq;
+        m_mutex.lock();
+        synchronize();
         if(lvl == all)
         {
-             return m_posts[index];
+            assert("The post index is out of bounds" && index < m_next - m_first);
+            seq = m_first + index;
         }
-        for(size_t i = 0, c = 0; i < m_posts.size(); ++i)
+        else
         {
-            if(m_posts[i].type == lvl)
-            {
-                if(c++ == index)
-                {
-                    return m_posts[static_cast<size_t>(i)];
-                }
-            }
+            assert("The post index is out of bounds" && index < m_levels[static_cast<size_t>(lvl)].size());
+            seq = m_levels[static_cast<size_t>(lvl)].get(index);
         }
-#define LCOV_EXCL_START
-        assert("The post index is out of bounds" && 0);
-#define LCOV_EXCL_STOP
+        post const p(m_posts[seq % m_posts.size()]);
+        m_mutex.unlock();
+        return p;
     }
     
     console::post console::history::get_post_to_level(size_t index, level lvl) const
     {
-        for(size_t i = 0, c = 0; i < m_posts.size(); ++i)
+        if(lvl == all || lvl == log)
+        {
+            return get_post(index, all);
+        }
+        m_mutex.lock();
+        synchronize();
+        assert("The post index is out of bounds" && index < m_to_levels[static_cast<size_t>(lvl)].size());
+        post const p(m_posts[m_to_levels[static_cast<size_t>(lvl)].get(index) % m_posts.size()]);
+        m_mutex.unlock();
+        return p;
+    }
+    
+    size_t console::history::get_sequence() const xpd_noexcept
+    {
+        m_mutex.lock();
+        synchronize();
+        size_t const seq = m_next;
+        m_mutex.unlock();
+        return seq;
+    }
+    
+    size_t console::history::get_posts_since(size_t seq, std::vector<post>& posts, level lvl) const
+    {
+        posts.clear();
+        m_mutex.lock();
+        synchronize();
+        for(size_t i = std::max(seq, m_first); i < m_next; ++i)
         {
-            if(m_posts[i].type <= lvl)
+            post const& p = m_posts[i % m_posts.size()];
+            if(lvl == all || p.type == lvl)
             {
-                ++c;
-                if(c == index+1)
-                {
-                    return m_posts[static_cast<size_t>(i)];
-                }
+                posts.push_back(p);
             }
         }
-#define LCOV_EXCL_START
-        assert("The post index is out of bounds" && 0);
-#define LCOV_EXCL_STOP
+        seq = m_next;
+        m_mutex.unlock();
+        return seq;
+    }
+    
+    size_t console::history::get_number_of_dropped_posts() const xpd_noexcept
+    {
+        return size_t(cpd_atomic_int_load(&m_queue->dropped));
     }
     
     void console::history::clear() xpd_noexcept
     {
-        m_counters[0] = m_counters[1] = m_counters[2] = m_counters[3] = 0ul;
-        m_posts.clear();
+        m_mutex.lock();
+        synchronize();
+        m_first = m_next = 0ul;
+        for(size_t i = 0; i < 4; ++i)
+        {
+            m_levels[i].clear();
+        }
+        for(size_t i = 0; i < 3; ++i)
+        {
+            m_to_levels[i].clear();
+        }
+        m_mutex.unlock();
     }
     
     void console::history::add(post const& mess) xpd_noexcept
     {
-        m_posts.push_back(mess);
-        assert("The post type can only be fatal, error, normal or log" && mess.type <= log);
-        m_counters[static_cast<size_t>(mess.type)]++;
+        add(mess.type, mess.text.c_str(), mess.repeat);
+    }
+    
+    void console::history::add(level type, char const* text, size_t repeat) xpd_noexcept
+    {
+        assert("The post type can only be fatal, error, normal or log" && type <= log);
+        m_queue->push(type, text, repeat);
     }
 }
\ No newline at end of file
@@ -8,6 +8,7 @@
 #define XPD_CONSOLE_HPP
 
 #include "xpd_def.hpp"
+#include "xpd_mutex.hpp"
 #include <string>
 #include <vector>
 
@@ -40,20 +41,33 @@ namespace xpd
         public:
             level       type;   //!< @brief The level of the post.
             std::string text;   //!< @brief The text of the post.
+            size_t      repeat; //!< @brief The number of repetitions of the post.
             
-            inline post(level t, std::string txt) xpd_noexcept : type(t), text(txt) {}
+            inline post(level t, std::string txt, size_t rep = 0) xpd_noexcept : type(t), text(txt), repeat(rep) {}
         };
         
         //! @brief A class that manages an history of posts.
         //! @details The history record posts and facilitates the retrieving of posts
-        //! from a specified level.
+        //! from a specified level. The history has a fixed capacity, when it is full the
+        //! oldest posts are removed. The posts of each level and to each level are indexed
+        //! so all the accessors are in constant time. The posts can be added by several
+        //! threads without lock, they are pushed in a bounded queue that is merged in the
+        //! history by the readers. The readers are only synchronized between them. If the
+        //! queue is full because the history isn't read often enough, the oldest post of
+        //! the queue is dropped, or the new one if a reader is still reading the oldest
+        //! one, so the writers return in bounded time. The writers never allocate memory, the texts are truncated
+        //! to 999 characters. A post with repetitions that follows an identical post is
+        //! merged into it.
         class history
         {
         public:
             //! @brief the constructor.
-            //! @details Preallocte space for posts
-            //! @todo later figure out if we should let the user specify the space.
-            history();
+            //! @details Preallocates the space for the posts and the indexes.
+            //! @param capacity The maximum number of posts in the history.
+            history(size_t capacity = 512);
+            
+            //! @brief The destructor.
+            ~history();
             
             //! @brief Gets the number of posts of a specified level.
             //! @details The count of posts by level is optimized to avoid unecessary extra
@@ -91,9 +105,62 @@ namespace xpd
             //! @brief Adds a post in the history.
             void add(post const& mess) xpd_noexcept;
             
+            //! @brief Adds a post in the history without copying its text in a string.
+            //! @param type The level of the post.
+            //! @param text The text of the post.
+            //! @param repeat The number of repetitions of the post.
+            void add(level type, char const* text, size_t repeat = 0) xpd_noexcept;
+            
+            //! @brief Gets the maximum number of posts in the history.
+            inline size_t capacity() const xpd_noexcept {return m_posts.size();}
+            
+            //! @brief Gets the sequence number of the next post.
+            //! @details The sequence number is the number of posts added to the history
+            //! since the last clear, it can be used as a cursor with get_posts_since.
+            size_t get_sequence() const xpd_noexcept;
+            
+            //! @brief Gets the posts added since a sequence number.
+            //! @details The posts are copied in one lock of the readers, the posts that
+            //! have already been removed from the history are ignored.
+            //! @param seq The sequence number returned by the previous call (0 the first time).
+            //! @param posts The vector to fill with the posts.
+            //! @param lvl The level of the posts (default level::all).
+            //! @return The sequence number to use for the next call.
+            size_t get_posts_since(size_t seq, std::vector<post>& posts, level lvl = all) const;
+            
+            //! @brief Gets the number of posts dropped because the queue was full.
+            size_t get_number_of_dropped_posts() const xpd_noexcept;
+            
         private:
-            size_t  m_counters[4];
-            std::vector<post> m_posts;
+            struct queue;
+            
+            history(history const& other) xpd_delete_f;
+            history& operator=(history const& other) xpd_delete_f;
+            void synchronize() const xpd_noexcept;
+            void insert(level type, char const* text, size_t repeat) const xpd_noexcept;
+            
+            // A ring of sequence numbers of posts.
+            class ring
+            {
+            public:
+                std::vector<size_t> m_seqs;
+                size_t              m_first;
+                size_t              m_next;
+                
+                inline ring() xpd_noexcept : m_first(0ul), m_next(0ul) {}
+                inline size_t size() const xpd_noexcept {return m_next - m_first;}
+                inline size_t get(size_t i) const xpd_noexcept {return m_seqs[(m_first + i) % m_seqs.size()];}
+                inline void push(size_t seq) xpd_noexcept {m_seqs[m_next++ % m_seqs.size()] = seq;}
+                inline void clear() xpd_noexcept {m_first = m_next = 0ul;}
+            };
+            
+            mutable std::vector<post>   m_posts;
+            mutable size_t              m_first;
+            mutable size_t              m_next;
+            mutable ring                m_levels[4];
+            mutable ring                m_to_levels[3];
+            mutable mutex               m_mutex;
+            queue*                      m_queue;
         };
     };
 }
@@ -52,5 +52,50 @@ namespace xpd
     {
         cpd_searchpath_clear();
     }
+    
+    void environment::searchpath_refresh() xpd_noexcept
+    {
+        cpd_searchpath_refresh();
+    }
+    
+    bool environment::patch_compile(std::string const& name, std::string const& path, std::string const& output) xpd_noexcept
+    {
+        return bool(cpd_patch_compile(name.c_str(), path.c_str(), output.c_str()));
+    }
+    
+    size_t environment::perform_allocations() xpd_noexcept
+    {
+        return cpd_memory_getperformallocations();
+    }
+    
+    size_t environment::collect() xpd_noexcept
+    {
+        return cpd_memory_collect();
+    }
+    
+    size_t environment::locked_memory() xpd_noexcept
+    {
+        return cpd_memory_getlockedsize();
+    }
+    
+    bool environment::lock_all_memory() xpd_noexcept
+    {
+        return bool(cpd_memory_lockall());
+    }
+    
+    void environment::huge_pages(bool state) xpd_noexcept
+    {
+        cpd_memory_sethugepages(state ? 1 : 0);
+    }
+    
+    bool environment::huge_pages() xpd_noexcept
+    {
+        return bool(cpd_memory_gethugepages());
+    }
+    
+    size_t environment::huge_pages_memory() xpd_noexcept
+    {
+        return cpd_memory_gethugepagessize();
+    }
 }
 
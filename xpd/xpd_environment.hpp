@@ -40,6 +40,49 @@ namespace xpd
         
         //! @brief Clears all the search path.
         static void searpath_clear() xpd_noexcept;
+        
+        //! @brief Refreshes the cache of the content of the search path.
+        //! @details Must be called if files have been added or removed in the directories.
+        static void searchpath_refresh() xpd_noexcept;
+        
+        //! @brief Converts a patch file to the binary format.
+        //! @details The binary files use the extension ".pdb" and are loaded faster.
+        //! @param name The name of the patch.
+        //! @param path The path of the patch.
+        //! @param output The path of the binary file.
+        //! @return true if the binary file has been written.
+        static bool patch_compile(std::string const& name, std::string const& path, std::string const& output) xpd_noexcept;
+        
+        //! @brief Gets the number of allocations made while performing the DSP.
+        //! @details The allocations of xpd and of Pure Data are counted.
+        static size_t perform_allocations() xpd_noexcept;
+        
+        //! @brief Frees the memory released by the asynchronous closings.
+        //! @details Frees the memory of the patches closed with instance::close_async and
+        //! of the instances destroyed with async_free.
+        //! @return The number of blocks freed.
+        static size_t collect() xpd_noexcept;
+        
+        //! @brief Locks all the memory mapped by the process.
+        //! @details The method isn't supported on Windows.
+        //! @return true if the memory has been locked.
+        static bool lock_all_memory() xpd_noexcept;
+        
+        //! @brief Gets the size of the memory locked by the instances.
+        //! @see instance::lock_memory
+        static size_t locked_memory() xpd_noexcept;
+        
+        //! @brief Sets the default huge page policy of the instances.
+        //! @details The policy only applies to the instances created afterward, the arrays
+        //! of at least 2 MB are then backed with huge pages, even if they are resized.
+        //! Only supported on Linux.
+        static void huge_pages(bool state) xpd_noexcept;
+        
+        //! @brief Gets the default huge page policy of the instances.
+        static bool huge_pages() xpd_noexcept;
+        
+        //! @brief Gets the size of the memory advised to be backed with huge pages.
+        static size_t huge_pages_memory() xpd_noexcept;
     };
 }
 
@@ -81,6 +81,26 @@ namespace xpd
     {
         return cpd_gui_get_number_of_steps(reinterpret_cast<cpd_gui const*>(m_ptr));
     }
+    
+    gui::slot gui::get_slot() const
+    {
+        cpd_gui_slot* ptr = cpd_gui_get_slot(reinterpret_cast<cpd_gui const*>(m_ptr));
+        if(!ptr)
+        {
+            throw "The gui isn't in the main canvas of a loaded patch.";
+        }
+        return slot(ptr);
+    }
+    
+    void gui::set_value(float value) const
+    {
+        get_slot().set_value(value);
+    }
+    
+    void gui::slot::set_value(float value) const xpd_noexcept
+    {
+        cpd_gui_slot_set_value(reinterpret_cast<cpd_gui_slot *>(m_ptr), value);
+    }
 }
 
 
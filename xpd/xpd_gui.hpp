@@ -63,6 +63,56 @@ namespace xpd
         float value() const xpd_noexcept;
         
         size_t nsteps() const xpd_noexcept;
+        
+        //! @brief The value slot of a gui.
+        //! @details The slot is retrieved once and sets the value of the gui without any
+        //! lookup or lock. It remains valid until the patch of the gui is closed.
+        class slot
+        {
+        public:
+            inline xpd_constexpr slot() xpd_noexcept : m_ptr(xpd_nullptr) {}
+            
+            inline xpd_constexpr operator bool() const xpd_noexcept {return (m_ptr != xpd_nullptr);}
+            
+            //! @brief Sets the value of the gui.
+            //! @details The value is applied by the instance at the next tick of the
+            //! processing without waiting for the processing.
+            //! @see instance::set_gui_smoothing
+            void set_value(float value) const xpd_noexcept;
+            
+        private:
+            inline xpd_constexpr slot(void* ptr) xpd_noexcept : m_ptr(ptr) {}
+            
+            void* m_ptr;
+            friend class gui;
+        };
+        
+        //! @brief Gets the value slot of the gui.
+        //! @details The gui must be in the main canvas of a loaded patch.
+        slot get_slot() const;
+        
+        //! @brief Sets the value of the gui.
+        //! @details The value is applied by the instance at the next tick of the processing
+        //! without waiting for the processing. The slot of the gui is retrieved at each
+        //! call, use get_slot for the frequent changes.
+        //! @see instance::set_gui_smoothing
+        void set_value(float value) const;
+    };
+    
+    //! @brief The state of a gui.
+    //! @details The state is a copy of the values of a gui retrieved by a snapshot of a
+    //! patch.
+    class gui_state
+    {
+    public:
+        gui             control;    //!< @brief The gui.
+        gui::type_t     type;       //!< @brief The type of the gui.
+        float           minimum;    //!< @brief The minimum value of the gui.
+        float           maximum;    //!< @brief The maximum value of the gui.
+        size_t          nsteps;     //!< @brief The number of steps of the gui.
+        float           value;      //!< @brief The current value of the gui.
+        
+        inline gui_state() xpd_noexcept : control(), type(gui::panel), minimum(0.f), maximum(0.f), nsteps(0), value(0.f) {}
     };
 }
 
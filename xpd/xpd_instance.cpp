@@ -33,12 +33,14 @@ namespace xpd
     public:        
         cpd_instance      object;
         instance*         ref;
-        static internal* allocate(instance* _ref)
+        bool              async;
+        static internal* allocate(instance* _ref, cpd_instance_config const& config)
         {
-            internal* ptr = (internal *)cpd_instance_new(sizeof(internal));
+            internal* ptr = (internal *)cpd_instance_new_ex(&config);
             if(ptr)
             {
                 ptr->ref = _ref;
+                ptr->async = false;
                 cpd_instance_post_sethook(reinterpret_cast<cpd_instance*>(ptr), (cpd_hook_post)func_post);
                 cpd_instance_midi_sethook(reinterpret_cast<cpd_instance*>(ptr), (cpd_midi_hook)func_midi);
             }
@@ -82,7 +84,7 @@ namespace xpd
         
         static void func_post(instance::internal* instance, cpd_post post)
         {
-            instance->ref->receive(console::post(console::level(post.level), std::string(post.text)));
+            instance->ref->receive(console::level(post.level), post.text, post.repeat);
         }
     };
     
@@ -92,7 +94,10 @@ namespace xpd
     
     instance::instance()
     {
-        m_ptr = internal::allocate(this);
+        cpd_instance_config config;
+        cpd_instance_config_init(&config);
+        config.size = sizeof(internal);
+        m_ptr = internal::allocate(this, config);
 #define LCOV_EXCL_START
         if(!m_ptr)
         {
@@ -101,10 +106,39 @@ namespace xpd
 #define LCOV_EXCL_STOP
     }
     
+    instance::instance(config const& c)
+    {
+        cpd_instance_config config;
+        cpd_instance_config_init(&config);
+        config.size             = sizeof(internal);
+        config.message_capacity = c.message_capacity;
+        config.midi_capacity    = c.midi_capacity;
+        config.ninputs          = c.ninputs;
+        config.noutputs         = c.noutputs;
+        config.samplerate       = c.samplerate;
+        config.lock_memory      = c.lock_memory ? 1 : 0;
+        config.huge_pages       = c.huge_pages ? 1 : 0;
+        m_ptr = internal::allocate(this, config);
+#define LCOV_EXCL_START
+        if(!m_ptr)
+        {
+            throw "can't allocate instance.";
+        }
+#define LCOV_EXCL_STOP
+        m_ptr->async = c.async_free;
+    }
+    
     instance::~instance() xpd_noexcept
     {
         release();
-        cpd_instance_free(reinterpret_cast<cpd_instance *>(m_ptr));
+        if(m_ptr->async)
+        {
+            cpd_instance_free_async(reinterpret_cast<cpd_instance *>(m_ptr));
+        }
+        else
+        {
+            cpd_instance_free(reinterpret_cast<cpd_instance *>(m_ptr));
+        }
     }
     
     
@@ -129,11 +163,48 @@ namespace xpd
         return p;
     }
     
+    patch instance::load(std::string const& name, std::string const& path, std::string const& text)
+    {
+        patch p;
+        void* ptr = cpd_instance_patch_load_from_memory(reinterpret_cast<cpd_instance *>(m_ptr), name.c_str(), path.c_str(), text.c_str(), text.size());
+        if(ptr)
+        {
+            p = patch(ptr, size_t(cpd_patch_get_dollarzero(reinterpret_cast<cpd_patch *>(ptr))));
+        }
+        return p;
+    }
+    
+    patch instance::clone(patch const& p)
+    {
+        patch c;
+        void* ptr = cpd_instance_patch_clone(reinterpret_cast<cpd_instance *>(m_ptr), reinterpret_cast<cpd_patch const *>(p.m_ptr));
+        if(ptr)
+        {
+            c = patch(ptr, size_t(cpd_patch_get_dollarzero(reinterpret_cast<cpd_patch *>(ptr))));
+        }
+        return c;
+    }
+    
     void instance::close(patch& p)
     {
         cpd_instance_patch_close(reinterpret_cast<cpd_instance *>(m_ptr), reinterpret_cast<cpd_patch *>(p.m_ptr));
     }
     
+    void instance::close_async(patch& p)
+    {
+        cpd_instance_patch_close_async(reinterpret_cast<cpd_instance *>(m_ptr), reinterpret_cast<cpd_patch *>(p.m_ptr));
+    }
+    
+    void instance::reindex(patch& p)
+    {
+        cpd_instance_patch_reindex(reinterpret_cast<cpd_instance *>(m_ptr), reinterpret_cast<cpd_patch *>(p.m_ptr));
+    }
+    
+    size_t instance::collect()
+    {
+        return cpd_instance_patch_collect(reinterpret_cast<cpd_instance *>(m_ptr));
+    }
+    
     
     int instance::samplerate() const xpd_noexcept
     {
@@ -155,6 +226,52 @@ namespace xpd
         cpd_instance_dsp_release(reinterpret_cast<cpd_instance *>(m_ptr));
     }
     
+    bool instance::lock_memory() xpd_noexcept
+    {
+        return bool(cpd_instance_dsp_lock_memory(reinterpret_cast<cpd_instance *>(m_ptr)));
+    }
+    
+    void instance::unlock_memory() xpd_noexcept
+    {
+        cpd_instance_dsp_unlock_memory(reinterpret_cast<cpd_instance *>(m_ptr));
+    }
+    
+    instance::batch::batch(instance& inst) xpd_noexcept : m_ptr(inst.m_ptr)
+    {
+        cpd_instance_begin_batch(reinterpret_cast<cpd_instance *>(m_ptr));
+    }
+    
+    instance::batch::~batch() xpd_noexcept
+    {
+        cpd_instance_end_batch(reinterpret_cast<cpd_instance *>(m_ptr));
+    }
+    
+    void instance::set_gui_smoothing(size_t nticks) xpd_noexcept
+    {
+        cpd_instance_gui_set_smoothing(reinterpret_cast<cpd_instance *>(m_ptr), nticks);
+    }
+    
+    void instance::set_post_level(console::level lvl) xpd_noexcept
+    {
+        cpd_instance_post_setlevel(reinterpret_cast<cpd_instance *>(m_ptr),
+                                   (lvl == console::all) ? cpd_post_log : static_cast<cpd_postlevel>(lvl));
+    }
+    
+    console::level instance::get_post_level() const xpd_noexcept
+    {
+        return console::level(cpd_instance_post_getlevel(reinterpret_cast<cpd_instance *>(m_ptr)));
+    }
+    
+    void instance::set_post_collapse(bool state) xpd_noexcept
+    {
+        cpd_instance_post_setcollapse(reinterpret_cast<cpd_instance *>(m_ptr), state ? 1 : 0);
+    }
+    
+    void instance::set_post_budget(size_t nposts) xpd_noexcept
+    {
+        cpd_instance_post_setbudget(reinterpret_cast<cpd_instance *>(m_ptr), nposts);
+    }
+    
     
     
     void instance::send(console::post const& post) const
@@ -162,6 +279,7 @@ namespace xpd
         cpd_post cpost;
         cpost.level = static_cast<cpd_postlevel>(post.type);
         cpost.text  = post.text.c_str();
+        cpost.repeat = post.repeat;
         cpd_instance_post_send(reinterpret_cast<cpd_instance *>(m_ptr), cpost);
     }
     
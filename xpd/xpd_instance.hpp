@@ -30,13 +30,38 @@ namespace xpd
     {
     public:
         
+        //! @brief The configuration of the creation of an instance.
+        struct config
+        {
+            //! @brief The default configuration.
+            config() xpd_noexcept : message_capacity(512), midi_capacity(512),
+            ninputs(0), noutputs(0), samplerate(0), lock_memory(false),
+            huge_pages(environment::huge_pages()), async_free(false) {}
+            
+            size_t  message_capacity;   //!< @brief The initial capacity of the queue of messages.
+            size_t  midi_capacity;      //!< @brief The initial capacity of the queue of midi events.
+            int     ninputs;            //!< @brief The number of inputs.
+            int     noutputs;           //!< @brief The number of outputs.
+            int     samplerate;         //!< @brief The sample rate or 0 to prepare the instance later.
+            bool    lock_memory;        //!< @brief Prefaults and locks the memory of the instance.
+            bool    huge_pages;         //!< @brief Backs the large arrays with huge pages.
+            bool    async_free;         //!< @brief Frees the memory of the patches later on destruction.
+        };
+        
         //! @brief The constructor for an empty instance.
         //! @details Creates an instance that can be used as an empty reference inside
         //! another class.
         instance();
         
+        //! @brief The constructor with a configuration.
+        //! @details The queues are allocated with their capacities and if the sample rate is
+        //! defined, the digital signal processing is prepared.
+        instance(config const& c);
+        
         //! @brief The destructor.
-        //! @details The instance will be destroyed if no other copy exists.
+        //! @details The instance will be destroyed if no other copy exists. If the
+        //! instance has been created with async_free, the large blocks of memory of its
+        //! patches are only freed by environment::collect.
         virtual ~instance() xpd_noexcept;
         
         //! @brief Gets the sample rate of the instance.
@@ -45,9 +70,36 @@ namespace xpd
         //! @brief Loads a patch.
         patch load(std::string const& name, std::string const& path);
         
+        //! @brief Loads a patch from a text in memory.
+        //! @param name The name of the patch.
+        //! @param path The virtual directory used to find the abstractions.
+        //! @param text The content of the patch.
+        patch load(std::string const& name, std::string const& path, std::string const& text);
+        
+        //! @brief Clones a patch that can belong to another instance.
+        //! @details The clone is created from the content used to load the patch.
+        patch clone(patch const& p);
+        
         //! @brief Closes a patch.
+        //! @details During a batch, the patch is still performed until the end of the batch.
         void close(patch& p);
         
+        //! @brief Closes a patch and frees its memory later.
+        //! @details The patch is removed from the DSP chain immediately but its large
+        //! blocks of memory are only freed by the collect method.
+        void close_async(patch& p);
+        
+        //! @brief Rebuilds the index of a patch after dynamic patching.
+        //! @details The objects retrieved by name or by tie use the index built at the
+        //! loading, it must be rebuilt once objects have been created, deleted or retied.
+        void reindex(patch& p);
+        
+        //! @brief Frees the memory of the patches closed with close_async.
+        //! @details The method doesn't lock the instance and should be called from a
+        //! thread that isn't time critical.
+        //! @return The number of patches closed since the last collection.
+        size_t collect();
+        
         //! @brief Prepares the digital signal processing chain of the instance.
         //! @param nins The number of inputs.
         //! @param nouts The number of outputs.
@@ -66,6 +118,60 @@ namespace xpd
         //! @brief Releases the digital signal processing chain of the instance.
         void release() xpd_noexcept;
         
+        //! @brief Prefaults and locks the memory of the instance.
+        //! @details Locks the audio buffers and the memory of the patches, the memory
+        //! allocated afterward is locked too until the memory is unlocked.
+        //! @return true if all the memory has been locked, the memory is prefaulted anyway.
+        bool lock_memory() xpd_noexcept;
+        
+        //! @brief Unlocks the memory of the instance.
+        void unlock_memory() xpd_noexcept;
+        
+        //! @brief A batch of changes of an instance.
+        //! @details The sorting of the DSP chain is deferred during the lifetime of the
+        //! batch, so the loadings and the closings of the patches sort the DSP chain only
+        //! once while the previous chain is still performed. The patches closed during the
+        //! batch keep sounding until the end of the batch.
+        class batch
+        {
+        public:
+            //! @brief Begins a batch.
+            batch(instance& inst) xpd_noexcept;
+            
+            //! @brief Ends the batch.
+            ~batch() xpd_noexcept;
+            
+        private:
+            batch(batch const& other) xpd_delete_f;
+            batch& operator=(batch const& other) xpd_delete_f;
+            void* m_ptr;
+        };
+        
+        //! @brief Sets the smoothing of the values set to the guis.
+        //! @details The sliders and the number boxes reach the values with a linear ramp.
+        //! @param nticks The number of ticks (blocks of 64 samples) of the ramps.
+        //! @see gui::set_value
+        void set_gui_smoothing(size_t nticks) xpd_noexcept;
+        
+        //! @brief Sets the level of the posts received by the instance.
+        //! @details The posts that are less important than the level are discarded before
+        //! their formatting when possible.
+        //! @param lvl The least important level of the posts (default console::log).
+        void set_post_level(console::level lvl) xpd_noexcept;
+        
+        //! @brief Gets the level of the posts received by the instance.
+        console::level get_post_level() const xpd_noexcept;
+        
+        //! @brief Enables or disables the collapsing of the repeated posts of Pure Data.
+        //! @details The repetitions of a post are received as a post with a repeat value.
+        //! @param state true to enable the collapsing.
+        void set_post_collapse(bool state) xpd_noexcept;
+        
+        //! @brief Sets the maximum number of posts of Pure Data received per second.
+        //! @details Only the posts made while the instance performs are limited.
+        //! @param nposts The maximum number of posts per second or 0 for no limit.
+        void set_post_budget(size_t nposts) xpd_noexcept;
+        
         //! @brief Sends a message through a tie.
         //! @param name The tie that will pass the vector of atoms.
         //! @param selector The selector.
@@ -104,6 +210,15 @@ namespace xpd
         //! @brief Receives a post from the console.
         //! @param post The console post received.
         virtual void receive(console::post const& post) {};
+        
+        //! @brief Receives the text of a post from the console.
+        //! @details The method is called by the thread that posts, that can be the audio
+        //! thread. By default, it creates a post and calls the method above, it can be
+        //! overridden to avoid the copy of the text, with console::history::add for example.
+        //! @param type The level of the post.
+        //! @param text The text of the post, only valid during the call.
+        //! @param repeat The number of repetitions of the post.
+        virtual void receive(console::level type, char const* text, size_t repeat) {receive(console::post(type, std::string(text), repeat));}
 #define LCOV_EXCL_STOP
         
     private:
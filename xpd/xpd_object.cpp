@@ -10,7 +10,6 @@
 extern "C"
 {
 #include "../cpd/cpd.h"
-#include <stdlib.h>
 }
 
 
@@ -28,11 +27,12 @@ namespace xpd
         cpd_object_get_text(reinterpret_cast<cpd_object const*>(m_ptr), &size, &text);
         if(size && text)
         {
-            std::string txt(text);
-            free(text);
+            std::string txt(text, size_t(size));
+            cpd_object_free_text(size, text);
             return txt;
         }
 #define LCOV_EXCL_START
+        cpd_object_free_text(size, text);
         return std::string();
 #define LCOV_EXCL_STOP
     }
@@ -56,6 +56,13 @@ namespace xpd
     {
         return cpd_object_get_height(reinterpret_cast<cpd_object const *>(m_ptr), reinterpret_cast<cpd_patch const*>(m_patch));
     }
+    
+    rectangle object::bounds() const xpd_noexcept
+    {
+        rectangle rect;
+        cpd_object_get_bounds(reinterpret_cast<cpd_object const *>(m_ptr), reinterpret_cast<cpd_patch const*>(m_patch), &rect.x, &rect.y, &rect.width, &rect.height);
+        return rect;
+    }
 }
 
 
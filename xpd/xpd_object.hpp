@@ -52,6 +52,11 @@ namespace xpd
         //! @brief Gets the height of the object.
         int height() const xpd_noexcept;
         
+        //! @brief Gets the bounds of the object.
+        //! @details The bounds are computed only once, it should be preferred to the
+        //! retrieving of the position and the size separately.
+        rectangle bounds() const xpd_noexcept;
+        
     protected:
         
         inline xpd_constexpr object(void const* patch, void* ptr) xpd_noexcept : m_patch(patch), m_ptr(ptr) {}
@@ -59,6 +64,21 @@ namespace xpd
         void const* m_patch;
         void*       m_ptr;
         friend class patch;
+        friend class patch::iterator;
+    };
+    
+    //! @brief The proxy returned by the member access operator of the iterator of a patch.
+    class patch::iterator::pointer
+    {
+    public:
+        //! @brief Accesses the object.
+        inline object const* operator->() const xpd_noexcept {return &m_object;}
+        
+    private:
+        inline pointer(object const& o) xpd_noexcept : m_object(o) {}
+        
+        object m_object;
+        friend class patch::iterator;
     };
 }
 
@@ -6,6 +6,8 @@
 
 #include "xpd_patch.hpp"
 #include "xpd_object.hpp"
+#include "xpd_gui.hpp"
+#include <algorithm>
 
 extern "C"
 {
@@ -13,7 +15,77 @@ extern "C"
 }
 
 namespace xpd
-{    
+{
+    // ==================================================================================== //
+    //                                          FILTER                                      //
+    // ==================================================================================== //
+    
+    patch::filter patch::filter::guis() xpd_noexcept
+    {
+        return filter(guis_t, xpd_nullptr);
+    }
+    
+    patch::filter patch::filter::name(symbol const& name)
+    {
+        return filter(name_t, cpd_symbol_create(name.name().c_str()));
+    }
+    
+    patch::filter patch::filter::receive_tie(tie const& name)
+    {
+        return filter(receive_tie_t, cpd_tie_create(name.name().c_str()));
+    }
+    
+    bool patch::filter::accept(void const* object) const xpd_noexcept
+    {
+        cpd_object const* obj = reinterpret_cast<cpd_object const *>(object);
+        if(m_type == guis_t)
+        {
+            return cpd_object_is_gui(obj);
+        }
+        else if(m_type == name_t)
+        {
+            return cpd_object_get_name(obj) == m_ptr;
+        }
+        else if(m_type == receive_tie_t)
+        {
+            return cpd_object_is_gui(obj) && cpd_gui_get_receive_tie(reinterpret_cast<cpd_gui const *>(obj)) == m_ptr;
+        }
+        return true;
+    }
+    
+    // ==================================================================================== //
+    //                                          ITERATOR                                    //
+    // ==================================================================================== //
+    
+    patch::iterator::reference patch::iterator::operator*() const xpd_noexcept
+    {
+        return object(m_patch, m_ptr);
+    }
+    
+    patch::iterator::pointer patch::iterator::operator->() const xpd_noexcept
+    {
+        return pointer(object(m_patch, m_ptr));
+    }
+    
+    patch::iterator& patch::iterator::operator++() xpd_noexcept
+    {
+        cpd_patch const* p = reinterpret_cast<cpd_patch const *>(m_patch);
+        cpd_object* obj = cpd_patch_get_next_object(p, reinterpret_cast<cpd_object *>(m_ptr));
+        while(obj && !m_filter.accept(obj))
+        {
+            obj = cpd_patch_get_next_object(p, obj);
+        }
+        m_ptr = obj;
+        return *this;
+    }
+    
+    patch::iterator patch::iterator::operator++(int) xpd_noexcept
+    {
+        iterator temp(*this);
+        ++(*this);
+        return temp;
+    }
+    
     // ==================================================================================== //
     //                                          PATCH                                       //
     // ==================================================================================== //
@@ -58,7 +130,130 @@ namespace xpd
         }
         return objects;
     }
+    
+    patch::iterator patch::begin(filter const& f) const xpd_noexcept
+    {
+        cpd_patch const* p = reinterpret_cast<cpd_patch const *>(m_ptr);
+        cpd_object* obj = cpd_patch_get_first_object(p);
+        while(obj && !f.accept(obj))
+        {
+            obj = cpd_patch_get_next_object(p, obj);
+        }
+        return iterator(m_ptr, obj, f);
+    }
+    
+    std::vector<rectangle> patch::bounds() const
+    {
+        cpd_patch const* p = reinterpret_cast<cpd_patch const *>(m_ptr);
+        std::vector<cpd_bounds> cbounds(cpd_patch_get_all_bounds(p, xpd_nullptr, 0));
+        std::vector<rectangle> rects;
+        if(!cbounds.empty())
+        {
+            cbounds.resize(cpd_patch_get_all_bounds(p, &cbounds[0], cbounds.size()));
+            rects.reserve(cbounds.size());
+            for(size_t i = 0; i < cbounds.size(); ++i)
+            {
+                rects.push_back(rectangle(cbounds[i].x, cbounds[i].y, cbounds[i].width, cbounds[i].height));
+            }
+        }
+        return rects;
+    }
+    
+    std::vector<object> patch::make_objects(std::vector<void*> const& ptrs) const
+    {
+        std::vector<object> objects;
+        objects.reserve(ptrs.size());
+        for(size_t i = 0; i < ptrs.size(); ++i)
+        {
+            objects.push_back(object(m_ptr, ptrs[i]));
+        }
+        return objects;
+    }
+    
+    std::vector<object> patch::objects(symbol const& name) const
+    {
+        cpd_patch const* p = reinterpret_cast<cpd_patch const *>(m_ptr);
+        cpd_symbol* s = cpd_symbol_create(name.name().c_str());
+        std::vector<void*> cobjects(cpd_patch_get_objects_by_name(p, s, xpd_nullptr, 0));
+        if(!cobjects.empty())
+        {
+            cobjects.resize(std::min(cobjects.size(), cpd_patch_get_objects_by_name(p, s, reinterpret_cast<cpd_object **>(&cobjects[0]), cobjects.size())));
+        }
+        return make_objects(cobjects);
+    }
+    
+    std::vector<object> patch::receivers(tie const& name) const
+    {
+        cpd_patch const* p = reinterpret_cast<cpd_patch const *>(m_ptr);
+        cpd_tie* t = cpd_tie_create(name.name().c_str());
+        std::vector<void*> cobjects(cpd_patch_get_objects_by_receive_tie(p, t, xpd_nullptr, 0));
+        if(!cobjects.empty())
+        {
+            cobjects.resize(std::min(cobjects.size(), cpd_patch_get_objects_by_receive_tie(p, t, reinterpret_cast<cpd_object **>(&cobjects[0]), cobjects.size())));
+        }
+        return make_objects(cobjects);
+    }
+    
+    std::vector<object> patch::senders(tie const& name) const
+    {
+        cpd_patch const* p = reinterpret_cast<cpd_patch const *>(m_ptr);
+        cpd_tie* t = cpd_tie_create(name.name().c_str());
+        std::vector<void*> cobjects(cpd_patch_get_objects_by_send_tie(p, t, xpd_nullptr, 0));
+        if(!cobjects.empty())
+        {
+            cobjects.resize(std::min(cobjects.size(), cpd_patch_get_objects_by_send_tie(p, t, reinterpret_cast<cpd_object **>(&cobjects[0]), cobjects.size())));
+        }
+        return make_objects(cobjects);
+    }
+    
+    void patch::snapshot(std::vector<gui_state>& states) const
+    {
+        cpd_patch const* p = reinterpret_cast<cpd_patch const *>(m_ptr);
+        std::vector<cpd_gui_state> cstates(cpd_patch_get_number_of_guis(p));
+        states.clear();
+        if(!cstates.empty())
+        {
+            cstates.resize(std::min(cstates.size(), cpd_patch_snapshot_guis(p, &cstates[0], cstates.size())));
+            states.reserve(cstates.size());
+            for(size_t i = 0; i < cstates.size(); ++i)
+            {
+                gui_state state;
+                state.control   = gui(object(m_ptr, cstates[i].gui));
+                state.type      = gui::type_t(cstates[i].type);
+                state.minimum   = cstates[i].minimum;
+                state.maximum   = cstates[i].maximum;
+                state.nsteps    = size_t(cstates[i].nsteps);
+                state.value     = cstates[i].value;
+                states.push_back(state);
+            }
+        }
+    }
+    
+    void patch::track_guis(bool state)
+    {
+        if(!cpd_patch_track_guis(reinterpret_cast<cpd_patch *>(m_ptr), state ? 1 : 0))
+        {
+            throw "The patch isn't valid.";
+        }
+    }
+    
+    void patch::changed_guis(std::vector<gui>& guis) const
+    {
+        cpd_patch const* p = reinterpret_cast<cpd_patch const *>(m_ptr);
+        std::vector<cpd_gui*> cguis(cpd_patch_get_number_of_guis(p));
+        guis.clear();
+        if(!cguis.empty())
+        {
+            cguis.resize(std::min(cguis.size(), cpd_patch_collect_changed_guis(p, &cguis[0], cguis.size())));
+            guis.reserve(cguis.size());
+            for(size_t i = 0; i < cguis.size(); ++i)
+            {
+                guis.push_back(gui(object(m_ptr, cguis[i])));
+            }
+        }
+    }
 }
 
 
 
+
@@ -8,10 +8,35 @@
 #define XPD_PATCH_HPP
 
 #include "xpd_instance.hpp"
+#include <iterator>
 
 namespace xpd
 {
     class object;
+    class gui;
+    class gui_state;
+    
+    // ==================================================================================== //
+    //                                          RECTANGLE                                   //
+    // ==================================================================================== //
+    
+    //! @brief The rectangle describes the bounds of an object within a patch.
+    class rectangle
+    {
+    public:
+        int x;      //!< @brief The x position.
+        int y;      //!< @brief The y position.
+        int width;  //!< @brief The width.
+        int height; //!< @brief The height.
+        
+        //! @brief The default constructor.
+        inline xpd_constexpr rectangle() xpd_noexcept : x(0), y(0), width(0), height(0) {}
+        
+        //! @brief The constructor.
+        inline xpd_constexpr rectangle(int _x, int _y, int _width, int _height) xpd_noexcept :
+        x(_x), y(_y), width(_width), height(_height) {}
+    };
+    
     // ==================================================================================== //
     //                                          PATCH                                       //
     // ==================================================================================== //
@@ -23,6 +48,91 @@ namespace xpd
     class patch
     {
     public:
+        
+        //! @brief The filter used to select the objects of a patch.
+        //! @details The filter is resolved once at the creation, so the iteration over
+        //! the objects never allocates memory and never throws exceptions.
+        class filter
+        {
+        public:
+            //! @brief The default constructor.
+            //! @details Creates a filter that accepts all the objects.
+            inline xpd_constexpr filter() xpd_noexcept : m_type(all_t), m_ptr(xpd_nullptr) {}
+            
+            //! @brief Creates a filter that only accepts the guis.
+            static filter guis() xpd_noexcept;
+            
+            //! @brief Creates a filter that only accepts the objects with a specific name.
+            //! @param name The name of the objects (bng, tgl, loadbang, etc.).
+            static filter name(symbol const& name);
+            
+            //! @brief Creates a filter that only accepts the guis bound to a receive tie.
+            //! @param name The receive tie of the guis.
+            static filter receive_tie(tie const& name);
+            
+        private:
+            enum type_t
+            {
+                all_t           = 0,
+                guis_t          = 1,
+                name_t          = 2,
+                receive_tie_t   = 3
+            };
+            
+            inline xpd_constexpr filter(type_t type, void const* ptr) xpd_noexcept : m_type(type), m_ptr(ptr) {}
+            bool accept(void const* object) const xpd_noexcept;
+            
+            type_t      m_type;
+            void const* m_ptr;
+            friend class patch;
+        };
+        
+        //! @brief The forward iterator over the objects of a patch.
+        //! @details The iterator walks directly through the objects of the patch and only
+        //! stops on the objects accepted by its filter. The objects are light handles
+        //! created on the fly, so the iterator returns them by value and its pointer is a
+        //! proxy that owns the object.
+        class iterator
+        {
+        public:
+            class pointer;
+            typedef std::forward_iterator_tag   iterator_category;
+            typedef object                      value_type;
+            typedef std::ptrdiff_t              difference_type;
+            typedef object                      reference;
+            
+            //! @brief The default constructor.
+            //! @details Creates an end iterator.
+            inline xpd_constexpr iterator() xpd_noexcept : m_patch(xpd_nullptr), m_ptr(xpd_nullptr), m_filter() {}
+            
+            //! @brief Gets the current object.
+            reference operator*() const xpd_noexcept;
+            
+            //! @brief Accesses the current object.
+            pointer operator->() const xpd_noexcept;
+            
+            //! @brief Moves to the next accepted object.
+            iterator& operator++() xpd_noexcept;
+            
+            //! @brief Moves to the next accepted object.
+            iterator operator++(int) xpd_noexcept;
+            
+            //! @brief Compares the iterator with another.
+            inline xpd_constexpr bool operator==(iterator const& other) const xpd_noexcept {return m_ptr == other.m_ptr;}
+            
+            //! @brief Compares the iterator with another.
+            inline xpd_constexpr bool operator!=(iterator const& other) const xpd_noexcept {return m_ptr != other.m_ptr;}
+            
+        private:
+            inline xpd_constexpr iterator(void const* patch, void* ptr, filter const& f) xpd_noexcept :
+            m_patch(patch), m_ptr(ptr), m_filter(f) {}
+            
+            void const* m_patch;
+            void*       m_ptr;
+            filter      m_filter;
+            friend class patch;
+        };
+        
         //! @brief The default constructor.
         //! @details Allocates an invalid patch.
         inline xpd_constexpr patch() xpd_noexcept : m_ptr(xpd_nullptr), m_unique_id(0ul) {};
@@ -63,9 +173,49 @@ namespace xpd
         
         //! @brief Gets the objects from the patch.
         std::vector<object> objects() const xpd_noexcept;
+        
+        //! @brief Gets the bounds of the objects from the patch.
+        //! @details The bounds are retrieved in one walk and in the same order as the
+        //! objects.
+        std::vector<rectangle> bounds() const;
+        
+        //! @brief Gets the objects of the patch with a specific name.
+        //! @details The objects are retrieved using the index of the patch, including the
+        //! objects of the subpatches.
+        std::vector<object> objects(symbol const& name) const;
+        
+        //! @brief Gets the objects of the patch bound to a receive tie.
+        //! @details The objects are retrieved using the index of the patch.
+        std::vector<object> receivers(tie const& name) const;
+        
+        //! @brief Gets the objects of the patch that send to a tie.
+        //! @details The objects are retrieved using the index of the patch.
+        std::vector<object> senders(tie const& name) const;
+        
+        //! @brief Gets the states of all the guis of the patch.
+        //! @details The states are retrieved in one pass while the processing is locked.
+        //! @param states The vector of states to fill.
+        void snapshot(std::vector<gui_state>& states) const;
+        
+        //! @brief Enables or disables the tracking of the changes of the guis.
+        //! @see changed_guis
+        void track_guis(bool state);
+        
+        //! @brief Gets the guis that changed since the last call.
+        //! @details The tracking of the guis must be enabled.
+        //! @param guis The vector of guis to fill.
+        void changed_guis(std::vector<gui>& guis) const;
+        
+        //! @brief Gets an iterator to the first object accepted by a filter.
+        //! @param f The filter (default all the objects).
+        iterator begin(filter const& f = filter()) const xpd_noexcept;
+        
+        //! @brief Gets the end iterator.
+        inline xpd_constexpr iterator end() const xpd_noexcept {return iterator();}
     private:
         
         inline xpd_constexpr patch(void* ptr, size_t uid) xpd_noexcept : m_ptr(ptr), m_unique_id(uid) {}
+        std::vector<object> make_objects(std::vector<void*> const& ptrs) const;
         
         void*  m_ptr;
         size_t m_unique_id;